@@ -0,0 +1,94 @@
+#include "arena.h"
+
+#include <iterator>
+#include <new>
+
+using namespace std;
+
+namespace runtime {
+
+    namespace {
+
+        thread_local Arena* current_arena = nullptr;
+
+        // Перед каждым объектом хранится арена, из которой он выделен (nullptr - куча)
+        struct alignas(max_align_t) AllocationHeader {
+            Arena* arena;
+        };
+
+        constexpr size_t ALIGNMENT = alignof(max_align_t);
+
+        constexpr size_t AlignUp(size_t size) {
+            return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+    }  // namespace
+
+    Arena::Scope::Scope()
+        : arena_(new Arena())
+        , previous_(current_arena) {
+        current_arena = arena_;
+    }
+
+    Arena::Scope::~Scope() {
+        current_arena = previous_;
+        arena_->scope_open_ = false;
+        arena_->DeleteIfUnused();
+    }
+
+    Arena* Arena::GetCurrent() {
+        return current_arena;
+    }
+
+    void* Arena::Allocate(size_t size) {
+        size = AlignUp(size);
+        ++live_count_;
+        if (size > BLOCK_SIZE / 4) {
+            // Крупный объект получает собственный блок, текущий блок продолжает заполняться
+            unique_ptr<byte[]> block(new byte[size]);
+            void* result = block.get();
+            blocks_.insert(blocks_.empty() ? blocks_.end() : prev(blocks_.end()), std::move(block));
+            return result;
+        }
+        if (used_ + size > BLOCK_SIZE) {
+            blocks_.emplace_back(new byte[BLOCK_SIZE]);
+            used_ = 0;
+        }
+        void* result = blocks_.back().get() + used_;
+        used_ += size;
+        return result;
+    }
+
+    void Arena::Release() {
+        --live_count_;
+        DeleteIfUnused();
+    }
+
+    void Arena::DeleteIfUnused() {
+        if (live_count_ == 0 && !scope_open_) {
+            delete this;
+        }
+    }
+
+    void* AllocateInArena(size_t size) {
+        const size_t total = sizeof(AllocationHeader) + size;
+        Arena* arena = current_arena;
+        void* memory = arena ? arena->Allocate(total) : ::operator new(total);
+        auto* header = new (memory) AllocationHeader{arena};
+        return header + 1;
+    }
+
+    void FreeInArena(void* ptr) noexcept {
+        if (!ptr) {
+            return;
+        }
+        auto* header = static_cast<AllocationHeader*>(ptr) - 1;
+        if (Arena* arena = header->arena) {
+            arena->Release();
+        }
+        else {
+            ::operator delete(header);
+        }
+    }
+
+}  // namespace runtime
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace runtime {
+
+    /*
+     * Арена для узлов синтаксического дерева одной программы. Память выделяется сдвигом
+     * указателя внутри крупных блоков, а отдельные объекты её не освобождают: все блоки
+     * освобождаются разом, когда уничтожен последний размещённый в арене объект
+     * и закрыта область Scope, в которой арена создавалась. Арена не потокобезопасна
+     */
+    class Arena {
+    public:
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+        // Создаёт новую арену и делает её текущей для потока на время своего существования.
+        // Объекты Executable, созданные в это время через new, размещаются в арене
+        class Scope {
+        public:
+            Scope();
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Arena* arena_;
+            Arena* previous_;
+        };
+
+        // Возвращает текущую арену потока либо nullptr
+        [[nodiscard]] static Arena* GetCurrent();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // Выделяет size байт, выровненных по alignof(std::max_align_t)
+        void* Allocate(size_t size);
+
+        // Сообщает об уничтожении размещённого в арене объекта
+        void Release();
+
+        // Количество размещённых в арене и ещё не уничтоженных объектов
+        [[nodiscard]] size_t GetLiveCount() const {
+            return live_count_;
+        }
+
+        [[nodiscard]] size_t GetBlockCount() const {
+            return blocks_.size();
+        }
+
+    private:
+        Arena() = default;
+        ~Arena() = default;
+
+        void DeleteIfUnused();
+
+        std::vector<std::unique_ptr<std::byte[]>> blocks_;
+        size_t used_ = BLOCK_SIZE;
+        size_t live_count_ = 0;
+        bool scope_open_ = true;
+    };
+
+    // Выделяет память под объект: в текущей арене потока, если она есть, иначе в куче
+    void* AllocateInArena(size_t size);
+
+    // Освобождает память, выделенную AllocateInArena
+    void FreeInArena(void* ptr) noexcept;
+
+}  // namespace runtime
@@ -0,0 +1,840 @@
+#include "bytecode.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+namespace bytecode {
+
+    using runtime::Closure;
+    using runtime::Context;
+    using runtime::ObjectHolder;
+
+    namespace {
+        const string SELF = "self"s;
+
+        // Значение ещё не проинициализированной локальной переменной
+        class UnboundValue : public runtime::Object {
+        public:
+            void Print([[maybe_unused]] std::ostream& os, [[maybe_unused]] Context& context) override {
+            }
+        };
+
+        UnboundValue& UnboundObject() {
+            static UnboundValue unbound;
+            return unbound;
+        }
+
+        const ObjectHolder& Unbound() {
+            static const ObjectHolder unbound = ObjectHolder::Share(UnboundObject());
+            return unbound;
+        }
+
+        bool IsUnbound(const ObjectHolder& object) {
+            return object.Get() == &UnboundObject();
+        }
+
+        using ComparatorPtr = bool (*)(const ObjectHolder&, const ObjectHolder&, Context&);
+
+        // Greater и LessOrEqual вызывают у экземпляра два метода программы. Первый из них может
+        // освободить объект, на который ссылается заимствованный регистр операнда, поэтому
+        // на время сравнения экземпляра операнды копируются
+        bool CompareHeld(ComparatorPtr compare, const ObjectHolder& lhs, const ObjectHolder& rhs,
+            Context& context) {
+            if (lhs.GetKind() != runtime::ObjectKind::ClassInstance) {
+                return compare(lhs, rhs, context);
+            }
+            const ObjectHolder lhs_copy = lhs;
+            const ObjectHolder rhs_copy = rhs;
+            return compare(lhs_copy, rhs_copy, context);
+        }
+
+        // Возвращает код операции для встроенной функции сравнения либо OpCode::Compare,
+        // если comparator задан пользователем
+        OpCode ComparisonOpCode(const Comparator& comparator) {
+            const auto* ptr = comparator.target<ComparatorPtr>();
+            if (ptr == nullptr) {
+                return OpCode::Compare;
+            }
+            if (*ptr == &runtime::Equal) {
+                return OpCode::Equal;
+            }
+            if (*ptr == &runtime::NotEqual) {
+                return OpCode::NotEqual;
+            }
+            if (*ptr == &runtime::Less) {
+                return OpCode::Less;
+            }
+            if (*ptr == &runtime::Greater) {
+                return OpCode::Greater;
+            }
+            if (*ptr == &runtime::LessOrEqual) {
+                return OpCode::LessOrEqual;
+            }
+            if (*ptr == &runtime::GreaterOrEqual) {
+                return OpCode::GreaterOrEqual;
+            }
+            return OpCode::Compare;
+        }
+
+        // Общее состояние компиляции одной программы
+        struct Session {
+            std::shared_ptr<VirtualMachine> machine;
+            std::unordered_set<const runtime::Class*> compiled_classes;
+        };
+
+        class Compiler {
+        public:
+            Compiler(Session& session, bool is_method, const vector<string>& params)
+                : session_(session) {
+                function_.is_method = is_method;
+                if (is_method) {
+                    DeclareLocal(SELF);
+                    for (const auto& param : params) {
+                        DeclareLocal(param);
+                    }
+                    function_.param_count = static_cast<uint32_t>(params.size());
+                    assigned_.assign(assigned_.size(), true);
+                }
+            }
+
+            Function Compile(const ast::Statement& body) {
+                CompileStatement(body);
+                Emit(OpCode::ReturnNone);
+                function_.register_count = std::max(function_.register_count, function_.local_count);
+                function_.field_caches.resize(function_.names.size());
+                function_.method_caches.resize(function_.calls.size());
+                return std::move(function_);
+            }
+
+        private:
+            uint32_t Here() const {
+                return static_cast<uint32_t>(function_.code.size());
+            }
+
+            uint32_t Emit(OpCode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+                function_.code.push_back({ op, a, b, c });
+                return Here() - 1;
+            }
+
+            uint32_t AddConstant(ObjectHolder value) {
+                function_.constants.push_back(std::move(value));
+                return static_cast<uint32_t>(function_.constants.size() - 1);
+            }
+
+            uint32_t AddName(const string& name) {
+                auto [it, inserted] = name_indices_.emplace(name, static_cast<uint32_t>(function_.names.size()));
+                if (inserted) {
+                    function_.names.push_back(name);
+                }
+                return it->second;
+            }
+
+            uint32_t DeclareLocal(const string& name) {
+                if (auto it = locals_.find(name); it != locals_.end()) {
+                    return it->second;
+                }
+                if (next_temp_ > function_.local_count) {
+                    throw CompileError("Variable "s + name + " declared inside an expression"s);
+                }
+                const uint32_t slot = function_.local_count++;
+                locals_.emplace(name, slot);
+                assigned_.push_back(false);
+                next_temp_ = function_.local_count;
+                return slot;
+            }
+
+            void ResetTemps() {
+                next_temp_ = function_.local_count;
+            }
+
+            uint32_t AllocTemps(uint32_t count) {
+                const uint32_t first = next_temp_;
+                next_temp_ += count;
+                function_.register_count = std::max(function_.register_count, next_temp_);
+                return first;
+            }
+
+            // Возвращает слот локальной переменной name, проверяя при необходимости,
+            // что ей присвоено значение. Если переменная не объявлена, возвращает nullopt
+            std::optional<uint32_t> ReadLocal(const string& name) {
+                auto it = locals_.find(name);
+                if (it == locals_.end()) {
+                    Emit(OpCode::Undefined, AddName(name));
+                    return std::nullopt;
+                }
+                if (!assigned_[it->second]) {
+                    Emit(OpCode::CheckBound, it->second, AddName(name));
+                }
+                return it->second;
+            }
+
+            void CompileClass(const ObjectHolder& holder) {
+                auto* cls = holder.TryAs<runtime::Class>();
+                if (cls == nullptr || !session_.compiled_classes.insert(cls).second) {
+                    return;
+                }
+                for (runtime::Method& method : cls->Methods()) {
+                    if (auto* lazy = dynamic_cast<ast::LazyMethodBody*>(method.body.get())) {
+                        // Тело компилируется сразу после разбора, при первом вызове метода
+                        lazy->SetTransform([machine = session_.machine, params = method.formal_params](
+                                               unique_ptr<runtime::Executable> body) {
+                            Session session{machine, {}};
+                            return CompileMethod(session, params, std::move(body));
+                        });
+                        continue;
+                    }
+                    if (dynamic_cast<const ast::MethodBody*>(method.body.get()) == nullptr) {
+                        continue;
+                    }
+                    method.body = CompileMethod(session_, method.formal_params, std::move(method.body));
+                }
+            }
+
+            static unique_ptr<runtime::Executable> CompileMethod(Session& session,
+                const vector<string>& params, unique_ptr<runtime::Executable> body) {
+                const auto& method_body = dynamic_cast<const ast::MethodBody&>(*body);
+                Function function = Compiler(session, true, params).Compile(method_body.GetBody());
+                return std::make_unique<CompiledMethod>(std::move(body), params, std::move(function),
+                    session.machine);
+            }
+
+            // Помещает значение выражения в регистр и возвращает его номер.
+            // Для локальной переменной возвращается её собственный слот.
+            // Если borrow равен true, значение используется только как операнд и до его
+            // использования не исполняется код программы, поэтому глобальные переменные и поля
+            // читаются в регистр без увеличения счётчика ссылок
+            uint32_t CompileOperand(const ast::Statement& expr, bool borrow = false) {
+                const auto* var = dynamic_cast<const ast::VariableValue*>(&expr);
+                if (var != nullptr && function_.is_method && var->GetDottedIds().size() == 1) {
+                    if (auto slot = ReadLocal(var->GetDottedIds().front())) {
+                        return *slot;
+                    }
+                    return AllocTemps(1);
+                }
+                const uint32_t reg = AllocTemps(1);
+                if (var != nullptr && borrow) {
+                    CompileVariable(*var, reg, true);
+                }
+                else {
+                    CompileTo(expr, reg);
+                }
+                return reg;
+            }
+
+            // Вычисляет операнды бинарной операции. Левый операнд вычисляется первым,
+            // поэтому заимствуется, только если вычисление правого не исполняет код программы
+            std::pair<uint32_t, uint32_t> CompileOperands(const ast::Statement& lhs, const ast::Statement& rhs) {
+                const uint32_t lhs_reg = CompileOperand(lhs, rhs.IsSideEffectFree());
+                return { lhs_reg, CompileOperand(rhs, true) };
+            }
+
+            void CompileVariable(const ast::VariableValue& var, uint32_t dst, bool borrow = false) {
+                const auto& ids = var.GetDottedIds();
+                uint32_t src = dst;
+                if (function_.is_method) {
+                    auto slot = ReadLocal(ids.front());
+                    if (!slot) {
+                        return;
+                    }
+                    src = *slot;
+                    if (ids.size() == 1 && src != dst) {
+                        Emit(OpCode::Move, dst, src);
+                    }
+                }
+                else {
+                    Emit(borrow ? OpCode::BorrowGlobal : OpCode::LoadGlobal, dst, AddName(ids.front()));
+                }
+                for (size_t i = 1; i < ids.size(); ++i) {
+                    Emit(borrow ? OpCode::BorrowField : OpCode::GetField, dst, src, AddName(ids[i]));
+                    src = dst;
+                }
+            }
+
+            void CompileMethodCall(const ast::MethodCall& call, uint32_t dst) {
+                const auto& args = call.GetArgs();
+                const auto argc = static_cast<uint32_t>(args.size());
+                const uint32_t self = AllocTemps(argc + 1);
+                CompileTo(call.GetObject(), self);
+
+                function_.calls.push_back({ call.GetMethodName(), argc });
+                const auto site = static_cast<uint32_t>(function_.calls.size() - 1);
+                const uint32_t check = Emit(OpCode::JumpIfNoMethod, self, site);
+                for (uint32_t i = 0; i < argc; ++i) {
+                    CompileTo(*args[i], self + 1 + i);
+                }
+                Emit(OpCode::Call, dst, self, site);
+                const uint32_t jump = Emit(OpCode::Jump);
+                function_.code[check].c = Here();
+                Emit(OpCode::LoadNone, dst);
+                function_.code[jump].a = Here();
+            }
+
+            void CompileNewInstance(const ast::NewInstance& instance, uint32_t dst) {
+                const auto& args = instance.GetArgs();
+                const auto argc = static_cast<uint32_t>(args.size());
+                const uint32_t self = AllocTemps(argc + 1);
+                for (uint32_t i = 0; i < argc; ++i) {
+                    CompileTo(*args[i], self + 1 + i);
+                }
+                function_.classes.push_back({ &instance.GetClass(), argc });
+                Emit(OpCode::NewInstance, dst, self, static_cast<uint32_t>(function_.classes.size() - 1));
+            }
+
+            void CompileComparison(const ast::Comparison& comparison, uint32_t dst) {
+                const OpCode op = ComparisonOpCode(comparison.GetComparator());
+                if (op != OpCode::Compare) {
+                    const auto [lhs, rhs] = CompileOperands(comparison.GetLhs(), comparison.GetRhs());
+                    Emit(op, dst, lhs, rhs);
+                    return;
+                }
+                const uint32_t args = AllocTemps(2);
+                CompileTo(comparison.GetLhs(), args);
+                CompileTo(comparison.GetRhs(), args + 1);
+                function_.comparators.push_back(comparison.GetComparator());
+                Emit(OpCode::Compare, dst, args, static_cast<uint32_t>(function_.comparators.size() - 1));
+            }
+
+            template <typename Node>
+            bool TryCompileBinary(const ast::Statement& expr, OpCode op, uint32_t dst) {
+                const auto* node = dynamic_cast<const Node*>(&expr);
+                if (node == nullptr) {
+                    return false;
+                }
+                const auto [lhs, rhs] = CompileOperands(node->GetLhs(), node->GetRhs());
+                Emit(op, dst, lhs, rhs);
+                return true;
+            }
+
+            // Вычисляет выражение expr и помещает результат в регистр dst
+            void CompileTo(const ast::Statement& expr, uint32_t dst) {
+                if (const auto* num = dynamic_cast<const ast::NumericConst*>(&expr)) {
+                    Emit(OpCode::LoadConst, dst, AddConstant(ObjectHolder::Own(runtime::Number{ num->GetValue() })));
+                }
+                else if (const auto* str = dynamic_cast<const ast::StringConst*>(&expr)) {
+                    Emit(OpCode::LoadConst, dst, AddConstant(ObjectHolder::Own(runtime::String{ str->GetValue() })));
+                }
+                else if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&expr)) {
+                    Emit(OpCode::LoadConst, dst,
+                        AddConstant(ObjectHolder::Own(runtime::Bool{ boolean->GetValue().GetValue() })));
+                }
+                else if (dynamic_cast<const ast::None*>(&expr)) {
+                    Emit(OpCode::LoadNone, dst);
+                }
+                else if (const auto* var = dynamic_cast<const ast::VariableValue*>(&expr)) {
+                    CompileVariable(*var, dst);
+                }
+                else if (const auto* call = dynamic_cast<const ast::MethodCall*>(&expr)) {
+                    CompileMethodCall(*call, dst);
+                }
+                else if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&expr)) {
+                    CompileNewInstance(*instance, dst);
+                }
+                else if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&expr)) {
+                    Emit(OpCode::Stringify, dst, CompileOperand(stringify->GetArgument()));
+                }
+                else if (const auto* negation = dynamic_cast<const ast::Not*>(&expr)) {
+                    Emit(OpCode::Not, dst, CompileOperand(negation->GetArgument(), true));
+                }
+                else if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&expr)) {
+                    CompileComparison(*comparison, dst);
+                }
+                else if (TryCompileBinary<ast::Add>(expr, OpCode::Add, dst)
+                    || TryCompileBinary<ast::Sub>(expr, OpCode::Sub, dst)
+                    || TryCompileBinary<ast::Mult>(expr, OpCode::Mult, dst)
+                    || TryCompileBinary<ast::Div>(expr, OpCode::Div, dst)
+                    || TryCompileBinary<ast::Or>(expr, OpCode::Or, dst)
+                    || TryCompileBinary<ast::And>(expr, OpCode::And, dst)) {
+                }
+                else {
+                    CompileStatement(expr);
+                    Emit(OpCode::LoadNone, dst);
+                }
+            }
+
+            void CompileIfElse(const ast::IfElse& if_else) {
+                const uint32_t condition = CompileOperand(if_else.GetCondition(), true);
+                const uint32_t check = Emit(OpCode::JumpIfFalse, condition);
+                ResetTemps();
+
+                const vector<bool> before = assigned_;
+                const bool terminated_before = terminated_;
+                CompileStatement(if_else.GetIfBody());
+                vector<bool> after_if = std::move(assigned_);
+                const bool if_terminated = terminated_;
+
+                assigned_ = before;
+                assigned_.resize(after_if.size(), false);
+                terminated_ = terminated_before;
+                if (const ast::Statement* else_body = if_else.GetElseBody()) {
+                    const uint32_t jump = Emit(OpCode::Jump);
+                    function_.code[check].b = Here();
+                    CompileStatement(*else_body);
+                    function_.code[jump].a = Here();
+                }
+                else {
+                    function_.code[check].b = Here();
+                }
+                assigned_.resize(std::max(assigned_.size(), after_if.size()), false);
+                after_if.resize(assigned_.size(), false);
+
+                // После if переменная считается присвоенной, только если ей присвоено значение
+                // в каждой ветке, которая может завершиться без return
+                if (if_terminated && !terminated_) {
+                    return;
+                }
+                if (!if_terminated && terminated_) {
+                    assigned_ = std::move(after_if);
+                    terminated_ = false;
+                    return;
+                }
+                for (size_t i = 0; i < assigned_.size(); ++i) {
+                    assigned_[i] = assigned_[i] && after_if[i];
+                }
+            }
+
+            void CompileAssignment(const string& name, const ast::Statement& value) {
+                if (function_.is_method) {
+                    const uint32_t slot = DeclareLocal(name);
+                    CompileTo(value, slot);
+                    assigned_[slot] = true;
+                    return;
+                }
+                const uint32_t reg = AllocTemps(1);
+                CompileTo(value, reg);
+                Emit(OpCode::StoreGlobal, AddName(name), reg);
+            }
+
+            void CompileStatement(const ast::Statement& stmt) {
+                if (const auto* compound = dynamic_cast<const ast::Compound*>(&stmt)) {
+                    for (const auto& child : compound->GetStatements()) {
+                        ResetTemps();
+                        CompileStatement(*child);
+                    }
+                }
+                else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&stmt)) {
+                    CompileAssignment(assignment->GetVarName(), assignment->GetRightValue());
+                }
+                else if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&stmt)) {
+                    const uint32_t object = CompileOperand(field->GetObject());
+                    const uint32_t value = CompileOperand(field->GetRightValue());
+                    Emit(OpCode::SetField, object, AddName(field->GetFieldName()), value);
+                }
+                else if (const auto* print = dynamic_cast<const ast::Print*>(&stmt)) {
+                    const auto& args = print->GetArgs();
+                    const auto argc = static_cast<uint32_t>(args.size());
+                    const uint32_t first = AllocTemps(argc);
+                    for (uint32_t i = 0; i < argc; ++i) {
+                        CompileTo(*args[i], first + i);
+                    }
+                    Emit(OpCode::Print, first, argc);
+                }
+                else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&stmt)) {
+                    CompileIfElse(*if_else);
+                }
+                else if (const auto* ret = dynamic_cast<const ast::Return*>(&stmt)) {
+                    Emit(OpCode::Return, CompileOperand(ret->GetStatement()));
+                    terminated_ = true;
+                }
+                else if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&stmt)) {
+                    const ObjectHolder& cls = definition->GetClass();
+                    CompileClass(cls);
+                    const auto& name = cls.TryAs<runtime::Class>()->GetName();
+                    if (function_.is_method) {
+                        const uint32_t slot = DeclareLocal(name);
+                        Emit(OpCode::LoadConst, slot, AddConstant(cls));
+                        assigned_[slot] = true;
+                    }
+                    else {
+                        const uint32_t reg = AllocTemps(1);
+                        Emit(OpCode::LoadConst, reg, AddConstant(cls));
+                        Emit(OpCode::StoreGlobal, AddName(name), reg);
+                    }
+                }
+                else if (dynamic_cast<const ast::MethodBody*>(&stmt)) {
+                    throw CompileError("Method body outside of a method"s);
+                }
+                else if (dynamic_cast<const ast::ValueStatement<runtime::Number>*>(&stmt)
+                    || dynamic_cast<const ast::ValueStatement<runtime::String>*>(&stmt)
+                    || dynamic_cast<const ast::ValueStatement<runtime::Bool>*>(&stmt)
+                    || dynamic_cast<const ast::None*>(&stmt)
+                    || dynamic_cast<const ast::VariableValue*>(&stmt)
+                    || dynamic_cast<const ast::MethodCall*>(&stmt)
+                    || dynamic_cast<const ast::NewInstance*>(&stmt)
+                    || dynamic_cast<const ast::UnaryOperation*>(&stmt)
+                    || dynamic_cast<const ast::BinaryOperation*>(&stmt)) {
+                    CompileTo(stmt, AllocTemps(1));
+                }
+                else {
+                    throw CompileError("Unsupported statement"s);
+                }
+            }
+
+            Session& session_;
+            Function function_;
+            unordered_map<string, uint32_t> locals_;
+            unordered_map<string, uint32_t> name_indices_;
+            // Для каждого локального слота: присвоено ли ему значение на любом пути выполнения
+            vector<bool> assigned_;
+            bool terminated_ = false;
+            uint32_t next_temp_ = 0;
+        };
+    }  // namespace
+
+    class VirtualMachine::FrameGuard {
+    public:
+        FrameGuard(VirtualMachine& machine, size_t base)
+            : machine_(machine)
+            , base_(base)
+            , pending_count_(machine.pending_methods_.size()) {
+        }
+
+        FrameGuard(const FrameGuard&) = delete;
+        FrameGuard& operator=(const FrameGuard&) = delete;
+
+        // Исключение может прервать кадр между JumpIfNoMethod и Call
+        ~FrameGuard() {
+            machine_.pending_methods_.resize(pending_count_);
+            machine_.PopFrame(base_);
+        }
+
+    private:
+        VirtualMachine& machine_;
+        size_t base_;
+        size_t pending_count_;
+    };
+
+    size_t VirtualMachine::PushFrame(const Function& function) {
+        const size_t base = top_;
+        top_ += function.register_count;
+        if (stack_.size() < top_) {
+            stack_.resize(top_);
+        }
+        for (size_t i = function.param_count + 1; i < function.local_count; ++i) {
+            stack_[base + i] = Unbound();
+        }
+        return base;
+    }
+
+    void VirtualMachine::PopFrame(size_t base) {
+        for (size_t i = base; i < top_; ++i) {
+            stack_[i] = ObjectHolder::None();
+        }
+        top_ = base;
+    }
+
+    ObjectHolder VirtualMachine::RunProgram(const Function& function, Closure& globals, Context& context) {
+        const size_t base = PushFrame(function);
+        FrameGuard guard(*this, base);
+        return Execute(function, base, &globals, context);
+    }
+
+    ObjectHolder VirtualMachine::CallMethod(const Function& function, const ObjectHolder& self,
+        const vector<ObjectHolder>& args, Context& context) {
+        const size_t base = PushFrame(function);
+        FrameGuard guard(*this, base);
+        stack_[base] = self;
+        for (size_t i = 0; i < args.size() && i < function.param_count; ++i) {
+            stack_[base + 1 + i] = args[i];
+        }
+        return Execute(function, base, nullptr, context);
+    }
+
+    ObjectHolder VirtualMachine::Invoke(const runtime::Method& method, size_t self_index, Context& context) {
+        runtime::Executable* body = method.body.get();
+        if (auto* lazy = dynamic_cast<ast::LazyMethodBody*>(body)) {
+            body = &lazy->Load();
+        }
+        const auto* compiled = dynamic_cast<const CompiledMethod*>(body);
+        if (compiled != nullptr && &compiled->GetMachine() == this) {
+            const Function& function = compiled->GetFunction();
+            const size_t base = PushFrame(function);
+            FrameGuard guard(*this, base);
+            for (size_t i = 0; i <= function.param_count; ++i) {
+                stack_[base + i] = stack_[self_index + i];
+            }
+            return Execute(function, base, nullptr, context);
+        }
+
+        auto first = stack_.begin() + static_cast<std::ptrdiff_t>(self_index + 1);
+        vector<ObjectHolder> args(first, first + static_cast<std::ptrdiff_t>(method.formal_params.size()));
+        auto* instance = stack_[self_index].TryAs<runtime::ClassInstance>();
+        return instance->Call(method, args, context);
+    }
+
+    ObjectHolder VirtualMachine::Execute(const Function& function, size_t base, Closure* globals,
+        Context& context) {
+        auto reg = [this, base](uint32_t index) -> ObjectHolder& {
+            return stack_[base + index];
+        };
+
+        // Методы, найденные JumpIfNoMethod, ждут своего Call в pending_methods_. Между ними
+        // вычисляются параметры, в которых могут быть вложенные вызовы, поэтому найденные методы
+        // образуют стек
+        const Instruction* code = function.code.data();
+        size_t pc = 0;
+        while (true) {
+            const Instruction& ins = code[pc++];
+            switch (ins.op) {
+            case OpCode::LoadConst:
+                reg(ins.a) = function.constants[ins.b];
+                break;
+            case OpCode::LoadNone:
+                reg(ins.a) = ObjectHolder::None();
+                break;
+            case OpCode::Move:
+                reg(ins.a) = reg(ins.b);
+                break;
+            case OpCode::LoadGlobal: {
+                auto it = globals->find(function.names[ins.b]);
+                if (it == globals->end()) {
+                    throw std::runtime_error("Cant find var"s);
+                }
+                reg(ins.a) = it->second;
+                break;
+            }
+            case OpCode::BorrowGlobal: {
+                auto it = globals->find(function.names[ins.b]);
+                if (it == globals->end()) {
+                    throw std::runtime_error("Cant find var"s);
+                }
+                reg(ins.a) = ObjectHolder::Borrow(it->second);
+                break;
+            }
+            case OpCode::StoreGlobal:
+                (*globals)[function.names[ins.a]] = reg(ins.b);
+                break;
+            case OpCode::CheckBound:
+                if (IsUnbound(reg(ins.a))) {
+                    throw std::runtime_error("Cant find var"s);
+                }
+                break;
+            case OpCode::Undefined:
+                throw std::runtime_error("Cant find var"s);
+            case OpCode::GetField: {
+                auto* instance = reg(ins.b).TryAs<runtime::ClassInstance>();
+                if (instance == nullptr) {
+                    throw std::runtime_error("This isn't object"s);
+                }
+                const ObjectHolder* field = function.field_caches[ins.c].Get(*instance, function.names[ins.c]);
+                if (field == nullptr) {
+                    throw std::runtime_error("Cant find var"s);
+                }
+                reg(ins.a) = *field;
+                break;
+            }
+            case OpCode::BorrowField: {
+                auto* instance = reg(ins.b).TryAs<runtime::ClassInstance>();
+                if (instance == nullptr) {
+                    throw std::runtime_error("This isn't object"s);
+                }
+                const ObjectHolder* field = function.field_caches[ins.c].Get(*instance, function.names[ins.c]);
+                if (field == nullptr) {
+                    throw std::runtime_error("Cant find var"s);
+                }
+                reg(ins.a) = ObjectHolder::Borrow(*field);
+                break;
+            }
+            case OpCode::SetField: {
+                auto* instance = reg(ins.a).TryAs<runtime::ClassInstance>();
+                if (instance == nullptr) {
+                    throw std::runtime_error("Cant find field"s);
+                }
+                function.field_caches[ins.b].Set(*instance, function.names[ins.b], reg(ins.c));
+                break;
+            }
+            case OpCode::Print: {
+                std::ostream& os = context.GetOutputStream();
+                for (uint32_t i = 0; i < ins.b; ++i) {
+                    if (i != 0) {
+                        os << ' ';
+                    }
+                    if (const ObjectHolder& obj = reg(ins.a + i)) {
+                        obj->Print(os, context);
+                    }
+                    else {
+                        os << "None"sv;
+                    }
+                }
+                os << '\n';
+                break;
+            }
+            case OpCode::Stringify: {
+                const ObjectHolder& obj = reg(ins.b);
+                if (!obj) {
+                    reg(ins.a) = ObjectHolder::Own(runtime::String{ "None"s });
+                    break;
+                }
+                runtime::DummyContext dummy_context;
+                obj->Print(dummy_context.output, dummy_context);
+                reg(ins.a) = ObjectHolder::Own(runtime::String{ dummy_context.output.str() });
+                break;
+            }
+            case OpCode::Add:
+                reg(ins.a) = runtime::Add(reg(ins.b), reg(ins.c), context);
+                break;
+            case OpCode::Sub:
+                reg(ins.a) = runtime::Sub(reg(ins.b), reg(ins.c));
+                break;
+            case OpCode::Mult:
+                reg(ins.a) = runtime::Mult(reg(ins.b), reg(ins.c));
+                break;
+            case OpCode::Div:
+                reg(ins.a) = runtime::Div(reg(ins.b), reg(ins.c));
+                break;
+            case OpCode::Or: {
+                const bool result = runtime::IsTrue(reg(ins.b)) || runtime::IsTrue(reg(ins.c));
+                reg(ins.a) = ObjectHolder::Own(runtime::Bool{ result });
+                break;
+            }
+            case OpCode::And: {
+                const bool result = runtime::IsTrue(reg(ins.b)) && runtime::IsTrue(reg(ins.c));
+                reg(ins.a) = ObjectHolder::Own(runtime::Bool{ result });
+                break;
+            }
+            case OpCode::Not:
+                reg(ins.a) = ObjectHolder::Own(runtime::Bool{ !runtime::IsTrue(reg(ins.b)) });
+                break;
+            case OpCode::Equal:
+                reg(ins.a) = ObjectHolder::Own(runtime::Bool{ runtime::Equal(reg(ins.b), reg(ins.c), context) });
+                break;
+            case OpCode::NotEqual:
+                reg(ins.a) = ObjectHolder::Own(runtime::Bool{ runtime::NotEqual(reg(ins.b), reg(ins.c), context) });
+                break;
+            case OpCode::Less:
+                reg(ins.a) = ObjectHolder::Own(runtime::Bool{ runtime::Less(reg(ins.b), reg(ins.c), context) });
+                break;
+            case OpCode::Greater:
+                reg(ins.a) = ObjectHolder::Own(
+                    runtime::Bool{ CompareHeld(&runtime::Greater, reg(ins.b), reg(ins.c), context) });
+                break;
+            case OpCode::LessOrEqual:
+                reg(ins.a) = ObjectHolder::Own(
+                    runtime::Bool{ CompareHeld(&runtime::LessOrEqual, reg(ins.b), reg(ins.c), context) });
+                break;
+            case OpCode::GreaterOrEqual:
+                reg(ins.a) = ObjectHolder::Own(
+                    runtime::Bool{ runtime::GreaterOrEqual(reg(ins.b), reg(ins.c), context) });
+                break;
+            case OpCode::Compare: {
+                const bool result = function.comparators[ins.c](reg(ins.b), reg(ins.b + 1), context);
+                reg(ins.a) = ObjectHolder::Own(runtime::Bool{ result });
+                break;
+            }
+            case OpCode::JumpIfNoMethod: {
+                const CallSite& site = function.calls[ins.b];
+                const auto* instance = reg(ins.a).TryAs<runtime::ClassInstance>();
+                const runtime::Method* method = instance == nullptr ? nullptr
+                    : function.method_caches[ins.b].Lookup(instance->GetClass(), site.method, site.argc);
+                if (method == nullptr) {
+                    pc = ins.c;
+                }
+                else {
+                    pending_methods_.push_back(method);
+                }
+                break;
+            }
+            case OpCode::Call: {
+                const runtime::Method& method = *pending_methods_.back();
+                pending_methods_.pop_back();
+                ObjectHolder result = Invoke(method, base + ins.b, context);
+                reg(ins.a) = std::move(result);
+                break;
+            }
+            case OpCode::NewInstance: {
+                const ClassSite& site = function.classes[ins.c];
+                reg(ins.b) = runtime::ClassInstance::Create(*site.cls);
+                if (const runtime::Method* init = site.cls->GetSpecialMethod(runtime::SpecialMethod::Init);
+                    init != nullptr && init->formal_params.size() == site.argc) {
+                    Invoke(*init, base + ins.b, context);
+                }
+                reg(ins.a) = reg(ins.b);
+                break;
+            }
+            case OpCode::Jump:
+                pc = ins.a;
+                break;
+            case OpCode::JumpIfFalse:
+                if (!runtime::IsTrue(reg(ins.a))) {
+                    pc = ins.b;
+                }
+                break;
+            case OpCode::Return:
+                return reg(ins.a);
+            case OpCode::ReturnNone:
+                return ObjectHolder::None();
+            }
+        }
+    }
+
+    CompiledMethod::CompiledMethod(std::unique_ptr<runtime::Executable> source, vector<string> param_names,
+        Function function, std::shared_ptr<VirtualMachine> machine)
+        : source_(std::move(source))
+        , param_names_(std::move(param_names))
+        , function_(std::move(function))
+        , machine_(std::move(machine)) {
+    }
+
+    ObjectHolder CompiledMethod::Execute(Closure& closure, Context& context) {
+        auto self = closure.find(SELF);
+        vector<ObjectHolder> args;
+        args.reserve(param_names_.size());
+        for (const auto& name : param_names_) {
+            auto it = closure.find(name);
+            args.push_back(it != closure.end() ? it->second : ObjectHolder::None());
+        }
+        return machine_->CallMethod(function_, self != closure.end() ? self->second : ObjectHolder::None(),
+            args, context);
+    }
+
+    ObjectHolder CompiledMethod::Invoke([[maybe_unused]] const runtime::Method& method,
+        const ObjectHolder& self, const vector<ObjectHolder>& args, Context& context) {
+        return machine_->CallMethod(function_, self, args, context);
+    }
+
+    const Function& CompiledMethod::GetFunction() const {
+        return function_;
+    }
+
+    const VirtualMachine& CompiledMethod::GetMachine() const {
+        return *machine_;
+    }
+
+    const runtime::Executable& CompiledMethod::GetSource() const {
+        return *source_;
+    }
+
+    Program::Program(std::unique_ptr<runtime::Executable> source, Function function,
+        std::shared_ptr<VirtualMachine> machine)
+        : source_(std::move(source))
+        , function_(std::move(function))
+        , machine_(std::move(machine)) {
+    }
+
+    ObjectHolder Program::Execute(Closure& closure, Context& context) {
+        machine_->RunProgram(function_, closure, context);
+        return ObjectHolder::None();
+    }
+
+    const Function& Program::GetFunction() const {
+        return function_;
+    }
+
+    std::unique_ptr<runtime::Executable> Compile(std::unique_ptr<runtime::Executable> program) {
+        return Compile(std::move(program), std::make_shared<VirtualMachine>());
+    }
+
+    std::unique_ptr<runtime::Executable> Compile(std::unique_ptr<runtime::Executable> program,
+        std::shared_ptr<VirtualMachine> machine) {
+        Session session{ std::move(machine), {} };
+        Function function = Compiler(session, false, {}).Compile(*program);
+        return std::make_unique<Program>(std::move(program), std::move(function), session.machine);
+    }
+
+}  // namespace bytecode
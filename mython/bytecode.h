@@ -0,0 +1,197 @@
+#pragma once
+
+#include "runtime.h"
+#include "statement.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bytecode {
+
+    // Коды операций регистровой виртуальной машины.
+    // R[i] обозначает i-й регистр текущего кадра, a, b, c - операнды инструкции
+    enum class OpCode : std::uint8_t {
+        LoadConst,       // R[a] = constants[b]
+        LoadNone,        // R[a] = None
+        Move,            // R[a] = R[b]
+        LoadGlobal,      // R[a] = globals[names[b]]
+        StoreGlobal,     // globals[names[a]] = R[b]
+        CheckBound,      // выбрасывает runtime_error, если переменной R[a] ещё не присвоено значение
+        Undefined,       // выбрасывает runtime_error: переменная names[a] не определена
+        GetField,        // R[a] = R[b].names[c]
+        BorrowGlobal,    // R[a] = globals[names[b]] без увеличения счётчика ссылок
+        BorrowField,     // R[a] = R[b].names[c] без увеличения счётчика ссылок
+        SetField,        // R[a].names[b] = R[c]
+        Print,           // print R[a], ..., R[a + b - 1]
+        Stringify,       // R[a] = str(R[b])
+        Add,             // R[a] = R[b] + R[c]
+        Sub,             // R[a] = R[b] - R[c]
+        Mult,            // R[a] = R[b] * R[c]
+        Div,             // R[a] = R[b] / R[c]
+        Or,              // R[a] = R[b] or R[c]
+        And,             // R[a] = R[b] and R[c]
+        Not,             // R[a] = not R[b]
+        Equal,           // R[a] = R[b] == R[c]
+        NotEqual,        // R[a] = R[b] != R[c]
+        Less,            // R[a] = R[b] < R[c]
+        Greater,         // R[a] = R[b] > R[c]
+        LessOrEqual,     // R[a] = R[b] <= R[c]
+        GreaterOrEqual,  // R[a] = R[b] >= R[c]
+        Compare,         // R[a] = comparators[c](R[b], R[b + 1])
+        JumpIfNoMethod,  // если у R[a] нет метода calls[b], переход на инструкцию c
+        Call,            // R[a] = R[b].calls[c](R[b + 1], ..., R[b + argc]); метод найден
+                         // парным JumpIfNoMethod
+        NewInstance,     // R[a] = R[b] = classes[c](R[b + 1], ..., R[b + argc])
+        Jump,            // переход на инструкцию a
+        JumpIfFalse,     // если R[a] приводится к False, переход на инструкцию b
+        Return,          // возвращает R[a]
+        ReturnNone,      // возвращает None
+    };
+
+    struct Instruction {
+        OpCode op;
+        std::uint32_t a = 0;
+        std::uint32_t b = 0;
+        std::uint32_t c = 0;
+    };
+
+    // Место вызова метода: имя метода и количество фактических параметров
+    struct CallSite {
+        std::string method;
+        std::uint32_t argc = 0;
+    };
+
+    // Место создания экземпляра класса
+    struct ClassSite {
+        const runtime::Class* cls = nullptr;
+        std::uint32_t argc = 0;
+    };
+
+    using Comparator = std::function<bool(const runtime::ObjectHolder&,
+        const runtime::ObjectHolder&, runtime::Context&)>;
+
+    /*
+     * Скомпилированная функция: тело метода либо программа верхнего уровня.
+     * Кадр метода устроен так: R[0] - self, R[1..param_count] - параметры,
+     * далее до local_count - локальные переменные, за ними - временные регистры.
+     * В программе верхнего уровня переменные хранятся в глобальном Closure,
+     * а все регистры - временные
+     */
+    struct Function {
+        std::vector<Instruction> code;
+        std::vector<runtime::ObjectHolder> constants;
+        std::vector<std::string> names;
+        std::vector<CallSite> calls;
+        std::vector<ClassSite> classes;
+        std::vector<Comparator> comparators;
+        // Кэши обращений к полям GetField и SetField, по одному на каждое имя из names
+        mutable std::vector<runtime::FieldCache> field_caches;
+        // Кэши поиска методов, по одному на каждое место вызова из calls
+        mutable std::vector<ast::MethodCache> method_caches;
+        std::uint32_t param_count = 0;
+        std::uint32_t local_count = 0;
+        std::uint32_t register_count = 0;
+        bool is_method = false;
+    };
+
+    // Регистровая виртуальная машина. Кадры всех вызовов размещаются в общем стеке регистров.
+    // Стек хранится в deque, чтобы его рост при вложенных вызовах не инвалидировал ссылки
+    // на регистры вызывающих кадров
+    class VirtualMachine {
+    public:
+        // Выполняет программу верхнего уровня, переменные которой хранятся в globals
+        runtime::ObjectHolder RunProgram(const Function& function, runtime::Closure& globals,
+            runtime::Context& context);
+
+        // Вызывает скомпилированный метод у объекта self с фактическими параметрами args
+        runtime::ObjectHolder CallMethod(const Function& function, const runtime::ObjectHolder& self,
+            const std::vector<runtime::ObjectHolder>& args, runtime::Context& context);
+
+    private:
+        class FrameGuard;
+
+        // Выделяет кадр для function на вершине стека и возвращает индекс его первого регистра
+        size_t PushFrame(const Function& function);
+        void PopFrame(size_t base);
+
+        runtime::ObjectHolder Execute(const Function& function, size_t base,
+            runtime::Closure* globals, runtime::Context& context);
+
+        // Вызывает метод method у объекта, лежащего в регистре stack_[self_index].
+        // Фактические параметры лежат в следующих за ним регистрах
+        runtime::ObjectHolder Invoke(const runtime::Method& method, size_t self_index,
+            runtime::Context& context);
+
+        std::deque<runtime::ObjectHolder> stack_;
+        size_t top_ = 0;
+        // Методы, найденные JumpIfNoMethod и ждущие своего Call, во всех активных кадрах
+        std::vector<const runtime::Method*> pending_methods_;
+    };
+
+    // Тело метода, исполняемое виртуальной машиной. Исходное дерево сохраняется как эталон
+    class CompiledMethod : public runtime::Executable {
+    public:
+        CompiledMethod(std::unique_ptr<runtime::Executable> source,
+            std::vector<std::string> param_names, Function function,
+            std::shared_ptr<VirtualMachine> machine);
+
+        // Берёт self и параметры метода из closure и исполняет байткод метода
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        // Исполняет байткод метода, передавая self и args виртуальной машине напрямую
+        runtime::ObjectHolder Invoke(const runtime::Method& method, const runtime::ObjectHolder& self,
+            const std::vector<runtime::ObjectHolder>& args, runtime::Context& context) override;
+
+        [[nodiscard]] const Function& GetFunction() const;
+        [[nodiscard]] const VirtualMachine& GetMachine() const;
+        [[nodiscard]] const runtime::Executable& GetSource() const;
+
+    private:
+        std::unique_ptr<runtime::Executable> source_;
+        std::vector<std::string> param_names_;
+        Function function_;
+        std::shared_ptr<VirtualMachine> machine_;
+    };
+
+    // Скомпилированная программа верхнего уровня
+    class Program : public runtime::Executable {
+    public:
+        Program(std::unique_ptr<runtime::Executable> source, Function function,
+            std::shared_ptr<VirtualMachine> machine);
+
+        // Исполняет программу, храня её переменные в closure. Возвращает None
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const Function& GetFunction() const;
+
+    private:
+        std::unique_ptr<runtime::Executable> source_;
+        Function function_;
+        std::shared_ptr<VirtualMachine> machine_;
+    };
+
+    class CompileError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /*
+     * Компилирует дерево, построенное ParseProgram, в байткод.
+     * Тела методов классов, объявленных в программе, заменяются на CompiledMethod,
+     * поэтому они исполняются виртуальной машиной независимо от того, кто их вызывает.
+     * Если в дереве встречается неизвестная инструкция, выбрасывается CompileError
+     */
+    std::unique_ptr<runtime::Executable> Compile(std::unique_ptr<runtime::Executable> program);
+
+    // Компилирует program для исполнения машиной machine. Части программы, разобранные
+    // по отдельности, компилируются для одной машины, чтобы вызовы методов между ними
+    // выполнялись без выхода из неё
+    std::unique_ptr<runtime::Executable> Compile(std::unique_ptr<runtime::Executable> program,
+        std::shared_ptr<VirtualMachine> machine);
+
+}  // namespace bytecode
@@ -0,0 +1,345 @@
+#include "bytecode.h"
+#include "collector.h"
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+
+#include "test_runner.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace bytecode {
+
+namespace {
+
+string RunTreeWalker(const string& program) {
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+string RunCompiled(const string& program) {
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto compiled = Compile(ParseProgram(lexer));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    compiled->Execute(closure, context);
+    return context.output.str();
+}
+
+void TestSameOutputAsTreeWalker() {
+    const vector<string> programs = {
+        R"(
+x = 4
+y = 5
+print x + y, x - y, x * y, y / x, -x
+print 'a' + "b", str(x) + str(None), not x, x and y, x or 0
+print x < y, x > y, x == y, x != y, x <= y, x >= y
+)"s,
+        R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __str__():
+    return '(' + str(self.x) + '; ' + str(self.y) + ')'
+
+  def __eq__(other):
+    return self.x == other.x and self.y == other.y
+
+  def __add__(other):
+    return self.x + other.x + self.y + other.y
+
+p = Point(1, 2)
+q = Point(3, 4)
+r = Point(1, 2)
+print p, q, p + q, p == q, p == r, p.missing()
+)"s,
+        R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+class Base:
+  def name():
+    return 'base'
+
+  def describe():
+    return 'I am ' + self.name()
+
+class Derived(Base):
+  def name():
+    result = 'derived'
+    return result
+
+f = Fib()
+b = Base()
+d = Derived()
+print f.calc(15), b.describe(), d.describe()
+)"s,
+    };
+
+    for (const auto& program : programs) {
+        ASSERT_EQUAL(RunCompiled(program), RunTreeWalker(program));
+    }
+}
+
+void TestLocalsLiveInRegisters() {
+    istringstream input(R"(
+class Counter:
+  def inc(x):
+    x = x + 1
+    return x
+
+c = Counter()
+print c.inc(41)
+)"s);
+    parse::Lexer lexer(input);
+    auto compiled = Compile(ParseProgram(lexer));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    compiled->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "42\n"s);
+
+    const auto& cls = *closure.at("Counter"s).TryAs<runtime::Class>();
+    const auto* method = dynamic_cast<const CompiledMethod*>(cls.GetMethod("inc"s)->body.get());
+    ASSERT(method != nullptr);
+
+    const auto& code = method->GetFunction().code;
+    ASSERT(none_of(code.begin(), code.end(), [](const Instruction& ins) {
+        return ins.op == OpCode::LoadGlobal || ins.op == OpCode::StoreGlobal
+            || ins.op == OpCode::CheckBound;
+    }));
+    // x = x + 1 компилируется в загрузку константы и сложение прямо в слот x
+    ASSERT_EQUAL(code.size(), 4U);
+}
+
+void TestUnassignedLocal() {
+    const string program = R"(
+class Test:
+  def run(flag):
+    if flag:
+      value = 'assigned'
+    return value
+
+t = Test()
+print t.run(True)
+print t.run(False)
+)"s;
+
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto compiled = Compile(ParseProgram(lexer));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ASSERT_THROWS(compiled->Execute(closure, context), runtime_error);
+    ASSERT_EQUAL(context.output.str(), "assigned\n"s);
+}
+
+void TestMethodsReturningSelf() {
+    // self, возвращённый методом или сохранённый из __init__, удерживает объект
+    // и после того, как исчезли все остальные ссылки на него
+    const string program = R"(
+class Registry:
+  def add(item):
+    self.last = item
+
+class A:
+  def __init__(v, registry):
+    self.v = v
+    registry.add(self)
+    return self
+
+  def __add__(other):
+    return self
+
+  def me():
+    return self
+
+r = Registry()
+x = A(1, r) + 2
+print x.v
+y = A(2, r)
+print x.v, y.v
+z = y.me()
+y = None
+print z.v
+t = A(3, r)
+t = None
+w = A(4, Registry())
+print r.last.v, w.v
+)"s;
+
+    const string expected = "1\n1 2\n2\n3 4\n"s;
+    ASSERT_EQUAL(RunTreeWalker(program), expected);
+    ASSERT_EQUAL(RunCompiled(program), expected);
+}
+
+void TestCallSitesCacheMethods() {
+    istringstream input(R"(
+class Adder:
+  def add(x, y):
+    return x + y
+
+class Sum:
+  def __init__():
+    self.adder = Adder()
+
+  def run(x):
+    return self.adder.add(x, self.adder.add(x, 1))
+
+s = Sum()
+print s.run(1)
+print s.run(2)
+)"s);
+    parse::Lexer lexer(input);
+    auto compiled = Compile(ParseProgram(lexer));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    compiled->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "3\n5\n"s);
+
+    const auto& cls = *closure.at("Sum"s).TryAs<runtime::Class>();
+    const auto* method = dynamic_cast<const CompiledMethod*>(cls.GetMethod("run"s)->body.get());
+    ASSERT(method != nullptr);
+
+    // Метод ищется в классе только при первом выполнении каждого места вызова
+    const auto& caches = method->GetFunction().method_caches;
+    ASSERT_EQUAL(caches.size(), 2U);
+    for (const auto& cache : caches) {
+        ASSERT_EQUAL(cache.GetMisses(), 1U);
+        ASSERT_EQUAL(cache.GetHits(), 1U);
+    }
+}
+
+void TestCyclesCollectedDuringOneCall() {
+    // Вся работа выполняется внутри одного вызова верхнего уровня: каждый из 8191 вызовов
+    // build с depth > 0 создаёт пару экземпляров, ссылающихся друг на друга
+    const string program = R"(
+class Node:
+  def __init__(n):
+    self.n = n
+
+class Builder:
+  def build(depth):
+    if depth > 0:
+      a = Node(depth)
+      b = Node(depth)
+      a.other = b
+      b.other = a
+      x = self.build(depth - 1)
+      y = self.build(depth - 1)
+    return depth
+
+k = Builder()
+print k.build(13)
+)"s;
+
+    auto& collector = runtime::CycleCollector::GetInstance();
+    for (const auto& run : {RunTreeWalker, RunCompiled}) {
+        const size_t collected = collector.GetStats().collected;
+        ASSERT_EQUAL(run(program), "13\n"s);
+        ASSERT(collector.GetStats().collected > collected);
+    }
+}
+
+void TestOperandsAreBorrowed() {
+    istringstream input(R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def sum():
+    return self.x + self.y
+
+p = Point('a', 'b')
+q = p
+print p.sum(), p.x + q.y
+)"s);
+    parse::Lexer lexer(input);
+    auto compiled = Compile(ParseProgram(lexer));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    compiled->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "ab ab\n"s);
+
+    const auto& cls = *closure.at("Point"s).TryAs<runtime::Class>();
+    const auto* method = dynamic_cast<const CompiledMethod*>(cls.GetMethod("sum"s)->body.get());
+    ASSERT(method != nullptr);
+    const auto& code = method->GetFunction().code;
+    ASSERT_EQUAL(count_if(code.begin(), code.end(), [](const Instruction& ins) {
+        return ins.op == OpCode::BorrowField;
+    }), 2);
+    ASSERT(none_of(code.begin(), code.end(), [](const Instruction& ins) {
+        return ins.op == OpCode::GetField;
+    }));
+}
+
+void TestBorrowedOperandsOutliveMethodCalls() {
+    // Поле, прочитанное перед вызовом метода, который его изменяет, не заимствуется.
+    // Сравнение экземпляра вызывает __lt__, который освобождает строку из заимствованного
+    // правого операнда, а затем __eq__ с тем же операндом
+    const string program = R"(
+class Box:
+  def __init__(v):
+    self.v = v
+
+  def reset():
+    self.v = 'new'
+    return '!'
+
+class Cmp:
+  def __init__(box):
+    self.box = box
+
+  def __lt__(other):
+    self.box.v = 'changed'
+    return False
+
+  def __eq__(other):
+    return other == 'old'
+
+x = 'o'
+b = Box(x + 'ld')
+print b.v + b.reset()
+b.v = x + 'ld'
+c = Cmp(b)
+print c > b.v, b.v
+)"s;
+
+    const string expected = "old!\nFalse changed\n"s;
+    ASSERT_EQUAL(RunTreeWalker(program), expected);
+    ASSERT_EQUAL(RunCompiled(program), expected);
+}
+
+}  // namespace
+
+void RunBytecodeTests(TestRunner& tr) {
+    RUN_TEST(tr, bytecode::TestSameOutputAsTreeWalker);
+    RUN_TEST(tr, bytecode::TestLocalsLiveInRegisters);
+    RUN_TEST(tr, bytecode::TestUnassignedLocal);
+    RUN_TEST(tr, bytecode::TestMethodsReturningSelf);
+    RUN_TEST(tr, bytecode::TestCallSitesCacheMethods);
+    RUN_TEST(tr, bytecode::TestCyclesCollectedDuringOneCall);
+    RUN_TEST(tr, bytecode::TestOperandsAreBorrowed);
+    RUN_TEST(tr, bytecode::TestBorrowedOperandsOutliveMethodCalls);
+}
+
+}  // namespace bytecode
@@ -0,0 +1,113 @@
+#include "collector.h"
+
+#include "runtime.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+    CycleCollector& CycleCollector::GetInstance() {
+        // Сборщик не уничтожается, чтобы экземпляры в статических переменных можно было
+        // освобождать и после выхода из main
+        static CycleCollector* collector = new CycleCollector();
+        return *collector;
+    }
+
+    void CycleCollector::Track(ClassInstance* instance) {
+        instance->gc_next_ = head_;
+        if (head_) {
+            head_->gc_prev_ = instance;
+        }
+        head_ = instance;
+        ++stats_.tracked;
+    }
+
+    void CycleCollector::Untrack(ClassInstance* instance) {
+        if (instance->gc_prev_) {
+            instance->gc_prev_->gc_next_ = instance->gc_next_;
+        }
+        else {
+            head_ = instance->gc_next_;
+        }
+        if (instance->gc_next_) {
+            instance->gc_next_->gc_prev_ = instance->gc_prev_;
+        }
+        --stats_.tracked;
+    }
+
+    size_t CycleCollector::Collect() {
+        // Экземпляр, на который ссылается поле, если поле им владеет
+        auto owned_instance = [](const ObjectHolder& field) -> ClassInstance* {
+            if (field.kind_ != ObjectHolder::Kind::Owned) {
+                return nullptr;
+            }
+            return field.TryAs<ClassInstance>();
+        };
+
+        for (ClassInstance* instance = head_; instance; instance = instance->gc_next_) {
+            instance->gc_refs_ = instance->ref_count_;
+        }
+        for (ClassInstance* instance = head_; instance; instance = instance->gc_next_) {
+            for (const ObjectHolder& field : instance->fields_) {
+                if (ClassInstance* target = owned_instance(field)) {
+                    --target->gc_refs_;
+                }
+            }
+        }
+
+        // Экземпляры без владельцев размещены не в куче и считаются достижимыми
+        vector<ClassInstance*> pending;
+        for (ClassInstance* instance = head_; instance; instance = instance->gc_next_) {
+            if (instance->gc_refs_ > 0 || instance->ref_count_ == 0) {
+                instance->gc_refs_ = REACHABLE;
+                pending.push_back(instance);
+            }
+        }
+        while (!pending.empty()) {
+            ClassInstance* instance = pending.back();
+            pending.pop_back();
+            for (const ObjectHolder& field : instance->fields_) {
+                if (ClassInstance* target = owned_instance(field); target && target->gc_refs_ != REACHABLE) {
+                    target->gc_refs_ = REACHABLE;
+                    pending.push_back(target);
+                }
+            }
+        }
+
+        vector<ClassInstance*> garbage;
+        for (ClassInstance* instance = head_; instance; instance = instance->gc_next_) {
+            if (instance->gc_refs_ != REACHABLE) {
+                garbage.push_back(instance);
+            }
+        }
+        // Пока поля очищаются, мусорные экземпляры удерживаются дополнительной ссылкой,
+        // чтобы ни один из них не был удалён раньше, чем разорваны все циклы.
+        // Класс мусорного экземпляра мог быть уже уничтожен, поэтому к нему сборщик не обращается
+        for (ClassInstance* instance : garbage) {
+            ++instance->ref_count_;
+        }
+        for (ClassInstance* instance : garbage) {
+            vector<ObjectHolder> fields = std::move(instance->fields_);
+            instance->fields_.clear();
+        }
+        for (ClassInstance* instance : garbage) {
+            if (--instance->ref_count_ == 0) {
+                delete instance;
+            }
+        }
+
+        ++stats_.collections;
+        stats_.collected += garbage.size();
+        stats_.last_collected = garbage.size();
+        threshold_ = max(MIN_THRESHOLD, stats_.tracked * 2);
+        return garbage.size();
+    }
+
+    size_t CycleCollector::MaybeCollect() {
+        return stats_.tracked >= threshold_ ? Collect() : 0;
+    }
+
+}  // namespace runtime
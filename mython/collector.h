@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace runtime {
+
+    class ClassInstance;
+
+    // Статистика сборщика циклов
+    struct CollectorStats {
+        // Количество выполненных сборок
+        size_t collections = 0;
+        // Количество экземпляров, освобождённых всеми сборками и последней сборкой
+        size_t collected = 0;
+        size_t last_collected = 0;
+        // Количество существующих экземпляров классов
+        size_t tracked = 0;
+    };
+
+    /*
+     * Сборщик циклических ссылок между экземплярами классов. Подсчёт ссылок не освобождает
+     * экземпляры, ссылающиеся друг на друга через поля (a.other = b, b.other = a), поэтому
+     * сборщик отслеживает все экземпляры и находит среди них недостижимые извне пробным удалением:
+     * из счётчика ссылок каждого экземпляра вычитаются ссылки из полей других экземпляров.
+     * Экземпляры с ненулевым остатком и всё, что достижимо из них по полям, живы, остальные
+     * принадлежат мусорным циклам и освобождаются.
+     *
+     * Ссылки, которые не учитываются счётчиком (ObjectHolder::Share), сборщику не видны,
+     * поэтому сборку можно запускать только там, где на экземпляры в куче не ссылаются
+     * невладеющие ObjectHolder. Исполнение программы удерживает экземпляры только
+     * владеющими ссылками (self передаётся методам через ObjectHolder::Retain), поэтому
+     * ClassInstance::Create запускает MaybeCollect перед созданием каждого экземпляра.
+     * Экземпляры без владельцев (размещённые не в куче) сборщик не освобождает.
+     * Сборщик не потокобезопасен
+     */
+    class CycleCollector {
+    public:
+        // Число экземпляров, при котором MaybeCollect запускает первую сборку
+        static constexpr size_t MIN_THRESHOLD = 10000;
+
+        CycleCollector(const CycleCollector&) = delete;
+        CycleCollector& operator=(const CycleCollector&) = delete;
+
+        // Возвращает сборщик, отслеживающий экземпляры классов. Сборщик существует
+        // до завершения программы
+        [[nodiscard]] static CycleCollector& GetInstance();
+
+        // Освобождает недостижимые экземпляры и возвращает их количество
+        size_t Collect();
+
+        // Запускает сборку, если с момента предыдущей сборки число экземпляров выросло вдвое
+        // (но не меньше чем до MIN_THRESHOLD). Возвращает количество освобождённых экземпляров
+        size_t MaybeCollect();
+
+        [[nodiscard]] const CollectorStats& GetStats() const {
+            return stats_;
+        }
+
+    private:
+        friend class ClassInstance;
+
+        // Значение ClassInstance::gc_refs_ для экземпляров, достижимых извне
+        static constexpr std::int64_t REACHABLE = -1;
+
+        CycleCollector() = default;
+        ~CycleCollector() = default;
+
+        void Track(ClassInstance* instance);
+        void Untrack(ClassInstance* instance);
+
+        ClassInstance* head_ = nullptr;
+        size_t threshold_ = MIN_THRESHOLD;
+        CollectorStats stats_;
+    };
+
+}  // namespace runtime
@@ -1,362 +1,656 @@
-#include "lexer.h"
-
-#include <algorithm>
-#include <charconv>
-#include <unordered_map>
-#include <map>
-
-using namespace std;
-
-namespace parse {
-
-    bool operator==(const Token& lhs, const Token& rhs) {
-        using namespace token_type;
-
-        if (lhs.index() != rhs.index()) {
-            return false;
-        }
-        if (lhs.Is<Char>()) {
-            return lhs.As<Char>().value == rhs.As<Char>().value;
-        }
-        if (lhs.Is<Number>()) {
-            return lhs.As<Number>().value == rhs.As<Number>().value;
-        }
-        if (lhs.Is<String>()) {
-            return lhs.As<String>().value == rhs.As<String>().value;
-        }
-        if (lhs.Is<Id>()) {
-            return lhs.As<Id>().value == rhs.As<Id>().value;
-        }
-        return true;
-    }
-
-    bool operator!=(const Token& lhs, const Token& rhs) {
-        return !(lhs == rhs);
-    }
-
-    std::ostream& operator<<(std::ostream& os, const Token& rhs) {
-        using namespace token_type;
-
-#define VALUED_OUTPUT(type) \
-    if (auto p = rhs.TryAs<type>()) return os << #type << '{' << p->value << '}';
-
-        VALUED_OUTPUT(Number);
-        VALUED_OUTPUT(Id);
-        VALUED_OUTPUT(String);
-        VALUED_OUTPUT(Char);
-
-#undef VALUED_OUTPUT
-
-#define UNVALUED_OUTPUT(type) \
-    if (rhs.Is<type>()) return os << #type;
-
-        UNVALUED_OUTPUT(Class);
-        UNVALUED_OUTPUT(Return);
-        UNVALUED_OUTPUT(If);
-        UNVALUED_OUTPUT(Else);
-        UNVALUED_OUTPUT(Def);
-        UNVALUED_OUTPUT(Newline);
-        UNVALUED_OUTPUT(Print);
-        UNVALUED_OUTPUT(Indent);
-        UNVALUED_OUTPUT(Dedent);
-        UNVALUED_OUTPUT(And);
-        UNVALUED_OUTPUT(Or);
-        UNVALUED_OUTPUT(Not);
-        UNVALUED_OUTPUT(Eq);
-        UNVALUED_OUTPUT(NotEq);
-        UNVALUED_OUTPUT(LessOrEq);
-        UNVALUED_OUTPUT(GreaterOrEq);
-        UNVALUED_OUTPUT(None);
-        UNVALUED_OUTPUT(True);
-        UNVALUED_OUTPUT(False);
-        UNVALUED_OUTPUT(Eof);
-
-#undef UNVALUED_OUTPUT
-
-        return os << "Unknown token :("sv;
-    }
-
-    void  Lexer::LoadLexer() {
-        char c;
-        input_.get(c);
-        while (c == ' ' && DedentFlag == false) {
-            input_.get(c);
-        }
-        input_.putback(c);
-        LoadToken();
-    }
-
-
-    void Lexer::LoadIds() {
-        std::string str;
-        char c;
-        while (true) {
-            input_.get(c);
-            if (c == ' ' || c == '=' || c == '\n' || c == ':' || c == '*' || c == '-' || c == '/'
-                || c == '+' || c == '!' || c == '#' || c == '(' || c == ')' || c == ',' || c == '.') {
-                input_.putback(c);
-                break;
-            }
-            if (input_.eof()) {
-                break;
-            }
-            str.push_back(c);
-        }
-        std::map<std::string, Token> input_token;
-        input_token.insert({ "class" , token_type::Class{} }); 
-        input_token.insert({ "return" , token_type::Return{} }); 
-        input_token.insert({ "if", token_type::If{} });
-        input_token.insert({ "else", token_type::Else{} });
-        input_token.insert({ "def", token_type::Def{} });
-        input_token.insert({ "print", token_type::Print{} });
-        input_token.insert({ "and", token_type::And{} });
-        input_token.insert({ "or", token_type::Or{} });
-        input_token.insert({ "not", token_type::Not{} });
-        input_token.insert({ "None", token_type::None{} });
-        input_token.insert({ "True", token_type::True{} });
-        input_token.insert({ "False", token_type::False{} });
-
-         if (!str.empty() && std::find_if(str.begin(),
-            str.end(), [](unsigned char c) { return !std::isdigit(c); }) == str.end()) {
-            token_ = token_type::Number{ stoi(str) };
-         }
-         else if (input_token.count(str)!=0){
-             token_ = input_token.at(str);
-         }
-        else {
-
-            token_ = token_type::Id{ str };
-        }
-    }
-
-    void Lexer::LoadString() {
-        char c;
-        input_.get(c);
-        auto it = std::istreambuf_iterator<char>(input_);
-        auto end = std::istreambuf_iterator<char>();
-        std::string s;
-        while (true) {
-            if (it == end) {
-                break;
-            }
-            const char ch = *it;
-            if ((ch == '"' && c == '"') || (ch == '\'' && c == '\''))
-            {
-                ++it;
-                break;
-            }
-            else if (ch == '\\') {
-                ++it;
-                const char escaped_char = *(it);
-                switch (escaped_char) {
-                case 'n':
-                    s.push_back('\n');
-                    break;
-                case 't':
-                    s.push_back('\t');
-                    break;
-                case 'r':
-                    s.push_back('\r');
-                    break;
-                case '"':
-                    s.push_back('"');
-                    break;
-                case '\\':
-                    s.push_back('\\');
-                    break;
-                case '\'':
-                    s.push_back('\'');
-                    break;
-                default:
-                    throw LexerError("Not implemented"s);
-                }
-            }
-            else if (ch == '\n' || ch == '\r') {
-            }
-            else {
-                s.push_back(ch);
-            }
-            ++it;
-        }
-        token_ = token_type::String{ s };
-    }
-
-    void Lexer::LoadLogicSimbol() {
-        char c;
-        input_.get(c);
-        char b;
-        input_.get(b);
-        if (!input_.eof()) {
-            if (b == '=') {
-                switch (c)
-                {
-                case '=':
-                    token_ = token_type::Eq{};
-                    return;
-                case '!':
-                    token_ = token_type::NotEq{};
-                    return;
-                case '<':
-                    token_ = token_type::LessOrEq{};
-                    return;
-                case '>':
-                    token_ = token_type::GreaterOrEq{};
-                    return;
-                default:
-                    input_.putback(b);
-                    break;
-                }
-            }
-            else { input_.putback(b); }
-        }
-        token_ = token_type::Char{ c };
-    }
-
-    const Token& Lexer::CurrentToken() const {
-        return token_;
-    }
-
-    Lexer::Lexer(std::istream& input) : input_(input) {
-        LoadToken();
-        FirstTokenFlag = false;
-    }
-
-    void Lexer::LoadToken() {
-        char c;
-        input_.get(c);
-        if (c == '#') {
-            CommentFlag = true;
-        }
-        if (c == '\n') {
-            CommentFlag = false;
-        }
-        if (!CommentFlag) {
-            if (input_.eof()) {
-                Dedent != 0 ? Dedent = Dedent - 2, token_ = token_type::Dedent{} : token_ = token_type::Eof{};
-            }
-            else if (c == '\n') {
-                if (token_.Is<token_type::Newline>() || FirstTokenFlag) {
-                    LoadToken();
-                }
-                else {
-                    DedentFlag = true;
-                    token_ = token_type::Newline{};
-                }
-            }
-            else if ((c == '\'') || (c == '\"')) {
-                DedentFlag = false;
-                input_.putback(c);
-                LoadString();
-            }
-            else if (c == '-' || c == '*' || c == '/' || c == '+' || c == '!' || c == '<'
-                || c == '>' || c == '=' || c == ':' || c == '(' || c == ')' || c == ',' || c == '.') {
-                DedentFlag = false;
-                input_.putback(c);
-                LoadLogicSimbol();
-            }
-            else if (DedentFlag == true && c == ' ') {
-                while (c == ' ') {
-                    input_.get(c);
-                    Indent++;
-                }
-                input_.putback(c);
-                if (Indent == Dedent) {
-                    Indent = 0;
-                    LoadToken();
-                }
-                else {
-                    Indent % 2 != 0 ? throw LexerError("Bad indent") : Indent;
-                    if (Indent < Dedent) {
-                        size_t CountDedetns = Indent;
-                        token_ = token_type::Dedent{};
-                        Dedent = Dedent - 2;
-                        Indent = 0;
-                        if (Dedent != CountDedetns) {
-                            for (size_t i = 0; i < CountDedetns; i++) {
-                                input_.putback(' ');
-                            }
-                            DedentFlag = true;
-                        }
-                        else {
-                            DedentFlag = false;
-                        }
-                    }
-                    else {
-                        Dedent = Indent;
-                        Indent = 0;
-                        token_ = token_type::Indent{};
-                        DedentFlag = false;
-                    }
-                }
-            }
-            else {
-                DedentFlag = false;
-                input_.putback(c);
-                LoadIds();
-            }
-        }
-        else {
-            LoadToken();
-        }
-    }
-
-    Token Lexer::NextToken() {
-
-        char c;
-        input_.get(c);
-        if (c == '#') {
-            CommentFlag = true;
-        }
-        if (c == '\n' || input_.eof()) {
-            CommentFlag = false;
-        }
-        if (!CommentFlag) {
-            if (input_.eof()) {
-                if (Dedent != 0 && DedentFlag == true) {
-                    token_ = token_type::Dedent{};
-                    Dedent = Dedent - 2;
-                }
-                else if (token_.Is<token_type::Dedent>() || token_.Is<token_type::Indent>()) {
-                    token_ = token_type::Eof{};
-                }
-                else if (!token_.Is<token_type::Newline>() && !token_.Is<token_type::Eof>()) {
-                    token_ = token_type::Newline{};
-                }
-                else {
-                    token_ = token_type::Eof{};
-                }
-                return CurrentToken();
-            }
-            if (c == '\n') {
-                if (token_.Is<token_type::Newline>()) {
-                    return NextToken();
-                }
-                else {
-                    DedentFlag = true;
-                    token_ = token_type::Newline{};
-                    return CurrentToken();
-                }
-            }
-            else if (c == ' ' && DedentFlag == false) {
-                while (c == ' ') {
-                    input_.get(c);
-                }
-            }
-            else if (Dedent != 0 && c != ' ' && DedentFlag == true) {
-                input_.putback(c);
-                token_ = token_type::Dedent{};
-                Dedent = Dedent - 2;
-                return CurrentToken();
-            }
-            input_.putback(c);
-            LoadToken();
-            return CurrentToken();
-        }
-        else {
-            return NextToken();
-        }
-    }
-
-
-}  // namespace parse
-
+#include "lexer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace parse {
+
+    Symbol SymbolTable::Intern(std::string_view name) {
+        const auto lock = Lock();
+        if (const auto it = symbols_.find(name); it != symbols_.end()) {
+            return it->second;
+        }
+        const auto symbol = static_cast<Symbol>(names_.size());
+        const std::string& stored = names_.emplace_back(name);
+        symbols_.emplace(stored, symbol);
+        return symbol;
+    }
+
+    std::string_view SymbolTable::GetName(Symbol symbol) const {
+        const auto lock = Lock();
+        return names_.at(symbol);
+    }
+
+    size_t SymbolTable::GetSize() const {
+        const auto lock = Lock();
+        return names_.size();
+    }
+
+    void SymbolTable::EnableLocking() {
+        locking_ = true;
+    }
+
+    std::unique_lock<std::mutex> SymbolTable::Lock() const {
+        return locking_ ? std::unique_lock(mutex_) : std::unique_lock<std::mutex>();
+    }
+
+    bool operator==(const Token& lhs, const Token& rhs) {
+        return lhs.GetKind() == rhs.GetKind() && lhs.GetPayload() == rhs.GetPayload();
+    }
+
+    bool operator!=(const Token& lhs, const Token& rhs) {
+        return !(lhs == rhs);
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Token& rhs) {
+        using namespace token_type;
+
+#define VALUED_OUTPUT(type) \
+    if (auto p = rhs.TryAs<type>()) return os << #type << '{' << p->value << '}';
+
+        VALUED_OUTPUT(Number);
+        VALUED_OUTPUT(Char);
+
+#undef VALUED_OUTPUT
+
+        // Без таблицы символов можно вывести только номер имени или строки
+#define SYMBOL_OUTPUT(type) \
+    if (auto p = rhs.TryAs<type>()) return os << #type << "{#" << p->value << '}';
+
+        SYMBOL_OUTPUT(Id);
+        SYMBOL_OUTPUT(String);
+
+#undef SYMBOL_OUTPUT
+
+#define UNVALUED_OUTPUT(type) \
+    if (rhs.Is<type>()) return os << #type;
+
+        UNVALUED_OUTPUT(Class);
+        UNVALUED_OUTPUT(Return);
+        UNVALUED_OUTPUT(If);
+        UNVALUED_OUTPUT(Else);
+        UNVALUED_OUTPUT(Def);
+        UNVALUED_OUTPUT(Newline);
+        UNVALUED_OUTPUT(Print);
+        UNVALUED_OUTPUT(Indent);
+        UNVALUED_OUTPUT(Dedent);
+        UNVALUED_OUTPUT(And);
+        UNVALUED_OUTPUT(Or);
+        UNVALUED_OUTPUT(Not);
+        UNVALUED_OUTPUT(Eq);
+        UNVALUED_OUTPUT(NotEq);
+        UNVALUED_OUTPUT(LessOrEq);
+        UNVALUED_OUTPUT(GreaterOrEq);
+        UNVALUED_OUTPUT(None);
+        UNVALUED_OUTPUT(True);
+        UNVALUED_OUTPUT(False);
+        UNVALUED_OUTPUT(Eof);
+
+#undef UNVALUED_OUTPUT
+
+        return os << "Unknown token :("sv;
+    }
+
+    namespace {
+
+        // Распознаёт ключевое слово по длине и первому символу. Возвращает false,
+        // если str не является ключевым словом
+        bool LoadKeyword(std::string_view str, Token& token) {
+            switch (str.size()) {
+            case 2:
+                if (str == "if"sv) { token = token_type::If{}; return true; }
+                if (str == "or"sv) { token = token_type::Or{}; return true; }
+                break;
+            case 3:
+                switch (str[0]) {
+                case 'd':
+                    if (str == "def"sv) { token = token_type::Def{}; return true; }
+                    break;
+                case 'a':
+                    if (str == "and"sv) { token = token_type::And{}; return true; }
+                    break;
+                case 'n':
+                    if (str == "not"sv) { token = token_type::Not{}; return true; }
+                    break;
+                }
+                break;
+            case 4:
+                switch (str[0]) {
+                case 'e':
+                    if (str == "else"sv) { token = token_type::Else{}; return true; }
+                    break;
+                case 'N':
+                    if (str == "None"sv) { token = token_type::None{}; return true; }
+                    break;
+                case 'T':
+                    if (str == "True"sv) { token = token_type::True{}; return true; }
+                    break;
+                }
+                break;
+            case 5:
+                switch (str[0]) {
+                case 'c':
+                    if (str == "class"sv) { token = token_type::Class{}; return true; }
+                    break;
+                case 'p':
+                    if (str == "print"sv) { token = token_type::Print{}; return true; }
+                    break;
+                case 'F':
+                    if (str == "False"sv) { token = token_type::False{}; return true; }
+                    break;
+                }
+                break;
+            case 6:
+                if (str == "return"sv) { token = token_type::Return{}; return true; }
+                break;
+            }
+            return false;
+        }
+
+        bool IsIdChar(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+    }  // namespace
+
+    void Lexer::LoadIds() {
+        const size_t begin = pos_;
+        const bool is_number = std::isdigit(static_cast<unsigned char>(source_[pos_]));
+        while (pos_ < source_.size() && IsIdChar(source_[pos_])) {
+            ++pos_;
+        }
+        const std::string_view str = source_.substr(begin, pos_ - begin);
+
+        if (is_number && std::all_of(str.begin(), str.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            int value = 0;
+            const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+            if (ec != std::errc{}) {
+                throw LexerError("Number is too large"s);
+            }
+            token_ = token_type::Number{ value };
+        }
+        else if (!LoadKeyword(str, token_)) {
+            token_ = token_type::Id{ symbols_.Intern(str) };
+        }
+    }
+
+    void Lexer::LoadString() {
+        const char quote = source_[pos_++];
+        const size_t begin = pos_;
+        size_t end = begin;
+        while (end < source_.size() && source_[end] != quote && source_[end] != '\\'
+            && source_[end] != '\n' && source_[end] != '\r') {
+            ++end;
+        }
+        // Строка без escape-последовательностей заносится в таблицу без промежуточной копии
+        if (end == source_.size() || source_[end] == quote) {
+            token_ = token_type::String{ symbols_.Intern(source_.substr(begin, end - begin)) };
+            pos_ = std::min(end + 1, source_.size());
+            return;
+        }
+
+        std::string s(source_.substr(begin, end - begin));
+        pos_ = end;
+        while (pos_ < source_.size() || ReadLine()) {
+            const char ch = source_[pos_++];
+            if (ch == quote) {
+                break;
+            }
+            else if (ch == '\\') {
+                if (pos_ == source_.size()) {
+                    throw LexerError("Not implemented"s);
+                }
+                const char escaped_char = source_[pos_++];
+                switch (escaped_char) {
+                case 'n':
+                    s.push_back('\n');
+                    break;
+                case 't':
+                    s.push_back('\t');
+                    break;
+                case 'r':
+                    s.push_back('\r');
+                    break;
+                case '"':
+                    s.push_back('"');
+                    break;
+                case '\\':
+                    s.push_back('\\');
+                    break;
+                case '\'':
+                    s.push_back('\'');
+                    break;
+                default:
+                    throw LexerError("Not implemented"s);
+                }
+            }
+            else if (ch == '\n' || ch == '\r') {
+            }
+            else {
+                s.push_back(ch);
+            }
+        }
+        token_ = token_type::String{ symbols_.Intern(s) };
+    }
+
+    void Lexer::LoadLogicSimbol() {
+        const char c = source_[pos_++];
+        if (pos_ < source_.size() && source_[pos_] == '=') {
+            switch (c) {
+            case '=':
+                token_ = token_type::Eq{};
+                ++pos_;
+                return;
+            case '!':
+                token_ = token_type::NotEq{};
+                ++pos_;
+                return;
+            case '<':
+                token_ = token_type::LessOrEq{};
+                ++pos_;
+                return;
+            case '>':
+                token_ = token_type::GreaterOrEq{};
+                ++pos_;
+                return;
+            default:
+                break;
+            }
+        }
+        token_ = token_type::Char{ c };
+    }
+
+    const Token& Lexer::CurrentToken() const {
+        return token_;
+    }
+
+    namespace {
+
+        /*
+         * Кольцевой буфер без блокировок для передачи значений из одного потока в другой.
+         * TryPush вызывает только поток-производитель, TryPop - только поток-потребитель.
+         * Каждый поток держит копию индекса другого потока и перечитывает его,
+         * только когда буфер кажется ему полным или пустым. Индексы публикуются и перечитываются
+         * с последовательной согласованностью, на которую опирается Waiter
+         */
+        template <typename T, size_t Capacity>
+        class SpscRing {
+            static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        public:
+            // Кладёт value в буфер. Если буфер полон, возвращает false
+            bool TryPush(const T& value) {
+                const size_t tail = tail_.load(std::memory_order_relaxed);
+                if (tail - head_cache_ == Capacity) {
+                    head_cache_ = head_.load(std::memory_order_seq_cst);
+                    if (tail - head_cache_ == Capacity) {
+                        return false;
+                    }
+                }
+                items_[tail & (Capacity - 1)] = value;
+                tail_.store(tail + 1, std::memory_order_seq_cst);
+                return true;
+            }
+
+            // Забирает из буфера самое старое значение. Если буфер пуст, возвращает false
+            bool TryPop(T& value) {
+                const size_t head = head_.load(std::memory_order_relaxed);
+                if (head == tail_cache_) {
+                    tail_cache_ = tail_.load(std::memory_order_seq_cst);
+                    if (head == tail_cache_) {
+                        return false;
+                    }
+                }
+                value = items_[head & (Capacity - 1)];
+                head_.store(head + 1, std::memory_order_seq_cst);
+                return true;
+            }
+
+        private:
+            static constexpr size_t CACHE_LINE = 64;
+
+            std::array<T, Capacity> items_;
+            // Индексы потребителя и производителя лежат в разных строках кэша
+            alignas(CACHE_LINE) std::atomic<size_t> head_{0};
+            size_t tail_cache_ = 0;
+            alignas(CACHE_LINE) std::atomic<size_t> tail_{0};
+            size_t head_cache_ = 0;
+        };
+
+        /*
+         * Ожидание события из другого потока: сначала короткое активное ожидание, затем
+         * блокировка на условной переменной. Поток, сделавший событие возможным, вызывает
+         * Notify. Пока никто не заблокирован, Notify не захватывает мьютекс
+         */
+        class Waiter {
+        public:
+            // Вызывает try_once, пока она не вернёт true
+            template <typename TryOnce>
+            void Wait(TryOnce try_once) {
+                for (int spins = 0; spins < SPIN_LIMIT; ++spins) {
+                    if (try_once()) {
+                        return;
+                    }
+                }
+                std::unique_lock lock(mutex_);
+                // Запись waiting_ и чтения в try_once, как и публикация события перед Notify,
+                // последовательно согласованы, поэтому либо try_once увидит событие,
+                // либо Notify увидит ожидающий поток
+                waiting_.store(true, std::memory_order_seq_cst);
+                condition_.wait(lock, try_once);
+                waiting_.store(false, std::memory_order_relaxed);
+            }
+
+            void Notify() {
+                if (waiting_.load(std::memory_order_seq_cst)) {
+                    std::lock_guard lock(mutex_);
+                    condition_.notify_one();
+                }
+            }
+
+        private:
+            static constexpr int SPIN_LIMIT = 64;
+
+            std::mutex mutex_;
+            std::condition_variable condition_;
+            std::atomic<bool> waiting_{false};
+        };
+
+    }  // namespace
+
+    class Lexer::BackgroundLexer {
+    public:
+        explicit BackgroundLexer(std::istream& input)
+            : lexer_(input) {
+            lexer_.symbols_.EnableLocking();
+            thread_ = std::thread([this] {
+                Run();
+            });
+        }
+
+        BackgroundLexer(const BackgroundLexer&) = delete;
+        BackgroundLexer& operator=(const BackgroundLexer&) = delete;
+
+        ~BackgroundLexer() {
+            stop_.store(true, std::memory_order_seq_cst);
+            not_full_.Notify();
+            thread_.join();
+        }
+
+        // Возвращает следующую лексему. Ошибку разбора выбрасывает вместо лексемы,
+        // на которой она произошла
+        Token Pop() {
+            if (!finished_) {
+                Token token;
+                not_empty_.Wait([this, &token] {
+                    return ring_.TryPop(token);
+                });
+                not_full_.Notify();
+                if (!token.Is<token_type::Eof>()) {
+                    return token;
+                }
+                finished_ = true;
+            }
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            return token_type::Eof{};
+        }
+
+        SymbolTable& Symbols() {
+            return lexer_.symbols_;
+        }
+
+    private:
+        // 4096 лексем занимают 32 КиБ и помещаются в кэш L1
+        static constexpr size_t RING_CAPACITY = 4096;
+
+        void Run() {
+            try {
+                for (Token token = lexer_.CurrentToken(); Push(token) && !token.Is<token_type::Eof>();) {
+                    token = lexer_.NextToken();
+                }
+            }
+            catch (...) {
+                // Eof публикует error_ для потребителя
+                error_ = std::current_exception();
+                Push(token_type::Eof{});
+            }
+        }
+
+        // Кладёт лексему в буфер, дожидаясь в нём места. Возвращает false, если лексер
+        // уничтожается и лексемы больше не нужны
+        bool Push(Token token) {
+            bool pushed = false;
+            not_full_.Wait([this, &token, &pushed] {
+                pushed = ring_.TryPush(token);
+                return pushed || stop_.load(std::memory_order_seq_cst);
+            });
+            if (pushed) {
+                not_empty_.Notify();
+            }
+            return pushed;
+        }
+
+        Lexer lexer_;
+        SpscRing<Token, RING_CAPACITY> ring_;
+        // Потребитель ждёт лексем в not_empty_, производитель - места в not_full_
+        Waiter not_empty_;
+        Waiter not_full_;
+        std::exception_ptr error_;
+        std::atomic<bool> stop_{false};
+        bool finished_ = false;
+        std::thread thread_;
+    };
+
+    Lexer::Lexer(std::istream& input, LexerThreading threading) {
+        if (threading == LexerThreading::Background) {
+            background_ = std::make_unique<BackgroundLexer>(input);
+            token_ = background_->Pop();
+        }
+        else {
+            input_ = &input;
+            LoadToken();
+        }
+    }
+
+    Lexer::~Lexer() = default;
+
+    const SymbolTable& Lexer::GetSymbols() const {
+        return background_ ? background_->Symbols() : symbols_;
+    }
+
+    SymbolTable& Lexer::Symbols() {
+        return background_ ? background_->Symbols() : symbols_;
+    }
+
+    bool Lexer::ReadLine() {
+        if (input_ == nullptr || !std::getline(*input_, line_)) {
+            return false;
+        }
+        buffer_ += line_;
+        if (!input_->eof()) {
+            buffer_ += '\n';
+        }
+        source_ = buffer_;
+        return true;
+    }
+
+    Lexer::Lexer(std::string_view source)
+        : source_(source) {
+        LoadToken();
+    }
+
+    void Lexer::SkipSpaces() {
+        while (pos_ < source_.size() && (source_[pos_] == ' ' || source_[pos_] == '\t' || source_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    void Lexer::SkipComment() {
+        while (pos_ < source_.size() && source_[pos_] != '\n') {
+            ++pos_;
+        }
+    }
+
+    bool Lexer::LoadIndentation() {
+        const size_t line_begin = pos_;
+        while (pos_ < source_.size() && source_[pos_] == ' ') {
+            ++pos_;
+        }
+        const size_t indent = pos_ - line_begin;
+        SkipSpaces();
+        if (pos_ == source_.size() || source_[pos_] == '\n' || source_[pos_] == '#') {
+            // Пустые строки и строки из одного комментария не влияют на отступ
+            SkipComment();
+            if (pos_ < source_.size()) {
+                ++pos_;
+            }
+            return false;
+        }
+        line_start_ = false;
+
+        if (indent > indents_.back()) {
+            if (indent % 2 != 0) {
+                throw LexerError("Bad indent"s);
+            }
+            indents_.push_back(indent);
+            token_ = token_type::Indent{};
+            return true;
+        }
+        if (indent < indents_.back()) {
+            while (indent < indents_.back()) {
+                indents_.pop_back();
+                ++pending_dedents_;
+            }
+            if (indent != indents_.back()) {
+                throw LexerError("Bad indent"s);
+            }
+            --pending_dedents_;
+            token_ = token_type::Dedent{};
+            return true;
+        }
+        return false;
+    }
+
+    void Lexer::LoadToken() {
+        if (pending_dedents_ > 0) {
+            --pending_dedents_;
+            token_ = token_type::Dedent{};
+            return;
+        }
+        while (line_start_) {
+            if (pos_ == source_.size()) {
+                if (input_ != nullptr) {
+                    // Разобранные строки больше не нужны
+                    buffer_.clear();
+                    source_ = buffer_;
+                    pos_ = 0;
+                }
+                if (!ReadLine()) {
+                    break;
+                }
+            }
+            if (LoadIndentation()) {
+                return;
+            }
+        }
+
+        SkipSpaces();
+        if (pos_ < source_.size() && source_[pos_] == '#') {
+            SkipComment();
+        }
+
+        if (pos_ == source_.size()) {
+            if (!line_start_) {
+                // Последняя непустая строка всегда завершается лексемой Newline
+                line_start_ = true;
+                token_ = token_type::Newline{};
+            }
+            else if (indents_.size() > 1) {
+                indents_.pop_back();
+                token_ = token_type::Dedent{};
+            }
+            else {
+                token_ = token_type::Eof{};
+            }
+            return;
+        }
+
+        const char c = source_[pos_];
+        if (c == '\n') {
+            ++pos_;
+            line_start_ = true;
+            token_ = token_type::Newline{};
+        }
+        else if (c == '\'' || c == '"') {
+            LoadString();
+        }
+        else if (IsIdChar(c)) {
+            LoadIds();
+        }
+        else {
+            LoadLogicSimbol();
+        }
+    }
+
+    Token Lexer::NextToken() {
+        if (background_) {
+            token_ = background_->Pop();
+        }
+        else {
+            LoadToken();
+        }
+        return CurrentToken();
+    }
+
+    std::string Lexer::SkipIndentedBlock() {
+        if (background_) {
+            throw LexerError("Can't skip a block that is lexed in background"s);
+        }
+        if (!token_.Is<token_type::Newline>() || pending_dedents_ > 0) {
+            throw LexerError("Indented block must follow a new line"s);
+        }
+        const size_t begin = pos_;
+        size_t end = pos_;
+        while (pos_ < source_.size() || ReadLine()) {
+            const size_t line_begin = pos_;
+            while (pos_ < source_.size() && source_[pos_] == ' ') {
+                ++pos_;
+            }
+            const size_t indent = pos_ - line_begin;
+            SkipSpaces();
+            const bool blank = pos_ == source_.size() || source_[pos_] == '\n' || source_[pos_] == '#';
+            if (!blank && indent <= indents_.back()) {
+                break;
+            }
+            SkipComment();
+            if (pos_ < source_.size()) {
+                ++pos_;
+            }
+            if (!blank) {
+                // Пустые строки в конце блока к нему не относятся
+                end = pos_;
+            }
+        }
+        if (end == begin) {
+            throw LexerError("Expected an indented block"s);
+        }
+        std::string block(source_.substr(begin, end - begin));
+        pos_ = end;
+        LoadToken();
+        return block;
+    }
+
+}  // namespace parse
+
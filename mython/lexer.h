@@ -1,170 +1,351 @@
-#pragma once
-
-#include <iosfwd>
-#include <optional>
-#include <sstream>
-#include <stdexcept>
-#include <string>
-#include <variant>
-
-namespace parse {
-
-    namespace token_type {
-        struct Number {  // Лексема «число»
-            int value;   // число
-        };
-
-        struct Id {             // Лексема «идентификатор»
-            std::string value;  // Имя идентификатора
-        };
-
-        struct Char {    // Лексема «символ»
-            char value;  // код символа
-        };
-
-        struct String {  // Лексема «строковая константа»
-            std::string value;
-        };
-
-        struct Class {};    // Лексема «class»
-        struct Return {};   // Лексема «return»
-        struct If {};       // Лексема «if»
-        struct Else {};     // Лексема «else»
-        struct Def {};      // Лексема «def»
-        struct Newline {};  // Лексема «конец строки»
-        struct Print {};    // Лексема «print»
-        struct Indent {};  // Лексема «увеличение отступа», соответствует двум пробелам
-        struct Dedent {};  // Лексема «уменьшение отступа»
-        struct Eof {};     // Лексема «конец файла»
-        struct And {};     // Лексема «and»
-        struct Or {};      // Лексема «or»
-        struct Not {};     // Лексема «not»
-        struct Eq {};      // Лексема «==»
-        struct NotEq {};   // Лексема «!=»
-        struct LessOrEq {};     // Лексема «<=»
-        struct GreaterOrEq {};  // Лексема «>=»
-        struct None {};         // Лексема «None»
-        struct True {};         // Лексема «True»
-        struct False {};        // Лексема «False»
-    }  // namespace token_type
-
-    using TokenBase
-        = std::variant<token_type::Number, token_type::Id, token_type::Char, token_type::String,
-        token_type::Class, token_type::Return, token_type::If, token_type::Else,
-        token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
-        token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
-        token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
-        token_type::None, token_type::True, token_type::False, token_type::Eof>;
-
-    struct Token : TokenBase {
-        using TokenBase::TokenBase;
-
-        template <typename T>
-        [[nodiscard]] bool Is() const {
-            return std::holds_alternative<T>(*this);
-        }
-
-        template <typename T>
-        [[nodiscard]] const T& As() const {
-            return std::get<T>(*this);
-        }
-
-        template <typename T>
-        [[nodiscard]] const T* TryAs() const {
-            return std::get_if<T>(this);
-        }
-    };
-
-    bool operator==(const Token& lhs, const Token& rhs);
-    bool operator!=(const Token& lhs, const Token& rhs);
-
-    std::ostream& operator<<(std::ostream& os, const Token& rhs);
-
-    class LexerError : public std::runtime_error {
-    public:
-        using std::runtime_error::runtime_error;
-    };
-
-    class Lexer {
-    public:
-        explicit Lexer(std::istream& input);
-
-        // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
-        [[nodiscard]] const Token& CurrentToken() const;
-
-        // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
-        Token NextToken();
-
-        // Если текущий токен имеет тип T, метод возвращает ссылку на него.
-        // В противном случае метод выбрасывает исключение LexerError
-        template <typename T>
-        const T& Expect() const {
-            using namespace std::literals;
-            if (token_.Is<T>()) {
-                return token_.As<T>();
-            }
-            else {
-                throw LexerError("Not implemented"s);
-            }
-        }
-
-        // Метод проверяет, что текущий токен имеет тип T, а сам токен содержит значение value.
-        // В противном случае метод выбрасывает исключение LexerError
-        template <typename T, typename U>
-        void Expect(const U& value) const {
-            using namespace std::literals;
-            if (token_.Is<T>() && token_.As<T>().value == value) {
-            }
-            else {
-                throw LexerError("Not implemented"s);
-            }
-        }
-
-        // Если следующий токен имеет тип T, метод возвращает ссылку на него.
-        // В противном случае метод выбрасывает исключение LexerError
-        template <typename T>
-        const T& ExpectNext() {
-            using namespace std::literals;
-            LoadLexer();
-            using namespace std::literals;
-            if (token_.Is<T>()) {
-                return token_.As<T>();
-            }
-            else {
-                throw LexerError("Not implemented"s);
-            }
-        }
-
-        // Метод проверяет, что следующий токен имеет тип T, а сам токен содержит значение value.
-        // В противном случае метод выбрасывает исключение LexerError
-        template <typename T, typename U>
-        void ExpectNext(const U& value) {
-            using namespace std::literals;
-            LoadLexer();
-            if (token_.Is<T>() && token_.As<T>().value == value) {
-                return;
-            }
-            else {
-                throw LexerError("Not implemented"s);
-            }
-        }
-
-
-
-    private:
-        std::istream& input_;
-        Token token_;
-        size_t Indent = 0;
-        size_t Dedent = 0;
-        bool DedentFlag = true;
-        bool FirstTokenFlag = true;
-        bool CommentFlag = false;
-        void LoadLexer();
-        void LoadToken();
-        void LoadIds();
-        void LoadString();
-        void LoadLogicSimbol();
-
-    };
-
-}  // namespace parse
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace parse {
+
+    // Идентификатор строки в таблице символов программы
+    using Symbol = uint32_t;
+
+    /*
+     * Таблица символов программы. Каждой различной строке (имени идентификатора или
+     * строковой константе) назначается свой номер, поэтому сравнение имён сводится
+     * к сравнению чисел. Строки хранятся в таблице и не перемещаются при её росте
+     */
+    class SymbolTable {
+    public:
+        // Возвращает номер строки name, при первом обращении добавляя её в таблицу
+        Symbol Intern(std::string_view name);
+
+        [[nodiscard]] std::string_view GetName(Symbol symbol) const;
+
+        [[nodiscard]] size_t GetSize() const;
+
+        // Включает блокировку таблицы для работы с ней из нескольких потоков.
+        // Вызывается до того, как таблицей начнёт пользоваться второй поток
+        void EnableLocking();
+
+    private:
+        [[nodiscard]] std::unique_lock<std::mutex> Lock() const;
+
+        std::deque<std::string> names_;
+        std::unordered_map<std::string_view, Symbol> symbols_;
+        mutable std::mutex mutex_;
+        bool locking_ = false;
+    };
+
+    enum class TokenKind : uint8_t {
+        Number,
+        Id,
+        Char,
+        String,
+        Class,
+        Return,
+        If,
+        Else,
+        Def,
+        Newline,
+        Print,
+        Indent,
+        Dedent,
+        And,
+        Or,
+        Not,
+        Eq,
+        NotEq,
+        LessOrEq,
+        GreaterOrEq,
+        None,
+        True,
+        False,
+        Eof,
+    };
+
+    namespace token_type {
+        struct Number {  // Лексема «число»
+            static constexpr TokenKind KIND = TokenKind::Number;
+            int value;   // число
+        };
+
+        struct Id {  // Лексема «идентификатор»
+            static constexpr TokenKind KIND = TokenKind::Id;
+            Symbol value;  // Имя идентификатора в таблице символов лексера
+        };
+
+        struct Char {    // Лексема «символ»
+            static constexpr TokenKind KIND = TokenKind::Char;
+            char value;  // код символа
+        };
+
+        struct String {  // Лексема «строковая константа»
+            static constexpr TokenKind KIND = TokenKind::String;
+            Symbol value;  // Раскодированная строка в таблице символов лексера
+        };
+
+#define UNVALUED_TOKEN(type) \
+        struct type { \
+            static constexpr TokenKind KIND = TokenKind::type; \
+        }
+
+        UNVALUED_TOKEN(Class);        // Лексема «class»
+        UNVALUED_TOKEN(Return);       // Лексема «return»
+        UNVALUED_TOKEN(If);           // Лексема «if»
+        UNVALUED_TOKEN(Else);         // Лексема «else»
+        UNVALUED_TOKEN(Def);          // Лексема «def»
+        UNVALUED_TOKEN(Newline);      // Лексема «конец строки»
+        UNVALUED_TOKEN(Print);        // Лексема «print»
+        UNVALUED_TOKEN(Indent);       // Лексема «увеличение отступа», соответствует двум пробелам
+        UNVALUED_TOKEN(Dedent);       // Лексема «уменьшение отступа»
+        UNVALUED_TOKEN(Eof);          // Лексема «конец файла»
+        UNVALUED_TOKEN(And);          // Лексема «and»
+        UNVALUED_TOKEN(Or);           // Лексема «or»
+        UNVALUED_TOKEN(Not);          // Лексема «not»
+        UNVALUED_TOKEN(Eq);           // Лексема «==»
+        UNVALUED_TOKEN(NotEq);        // Лексема «!=»
+        UNVALUED_TOKEN(LessOrEq);     // Лексема «<=»
+        UNVALUED_TOKEN(GreaterOrEq);  // Лексема «>=»
+        UNVALUED_TOKEN(None);         // Лексема «None»
+        UNVALUED_TOKEN(True);         // Лексема «True»
+        UNVALUED_TOKEN(False);        // Лексема «False»
+
+#undef UNVALUED_TOKEN
+
+        // Лексемы, несущие значение
+        template <typename T>
+        inline constexpr bool HAS_VALUE = T::KIND == TokenKind::Number || T::KIND == TokenKind::Id
+                                          || T::KIND == TokenKind::Char || T::KIND == TokenKind::String;
+    }  // namespace token_type
+
+    class LexerError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /*
+     * Лексема: вид и 32-битное значение. Идентификаторы и строки хранятся
+     * в значении номером в таблице символов лексера, поэтому лексема занимает
+     * 8 байт и копируется без выделения памяти
+     */
+    class Token {
+    public:
+        Token() = default;
+
+        template <typename T, typename = decltype(T::KIND)>
+        Token(T token)  // NOLINT(google-explicit-constructor)
+            : kind_(T::KIND) {
+            if constexpr (token_type::HAS_VALUE<T>) {
+                payload_ = static_cast<uint32_t>(token.value);
+            }
+        }
+
+        [[nodiscard]] TokenKind GetKind() const {
+            return kind_;
+        }
+
+        [[nodiscard]] uint32_t GetPayload() const {
+            return payload_;
+        }
+
+        template <typename T>
+        [[nodiscard]] bool Is() const {
+            return kind_ == T::KIND;
+        }
+
+        template <typename T>
+        [[nodiscard]] T As() const {
+            using namespace std::literals;
+            if (!Is<T>()) {
+                throw LexerError("Unexpected token kind"s);
+            }
+            if constexpr (token_type::HAS_VALUE<T>) {
+                return T{static_cast<decltype(T::value)>(payload_)};
+            }
+            else {
+                return T{};
+            }
+        }
+
+        template <typename T>
+        [[nodiscard]] std::optional<T> TryAs() const {
+            if (!Is<T>()) {
+                return std::nullopt;
+            }
+            return As<T>();
+        }
+
+    private:
+        TokenKind kind_ = TokenKind::Eof;
+        uint32_t payload_ = 0;
+    };
+
+    static_assert(sizeof(Token) == 8);
+
+    bool operator==(const Token& lhs, const Token& rhs);
+    bool operator!=(const Token& lhs, const Token& rhs);
+
+    std::ostream& operator<<(std::ostream& os, const Token& rhs);
+
+    // Поток, в котором текст разбирается на лексемы
+    enum class LexerThreading {
+        // Лексемы разбираются при вызове NextToken
+        Inline,
+        // Лексемы разбираются заранее в отдельном потоке и передаются через кольцевой буфер.
+        // Ошибка разбора выбрасывается, когда NextToken доходит до места ошибки
+        Background,
+    };
+
+    /*
+     * Лексический анализатор. Работает над непрерывным буфером с текстом программы.
+     * Идентификаторы и строковые константы заносятся в таблицу символов лексера,
+     * а лексемы хранят только их номера
+     */
+    class Lexer {
+    public:
+        // Разбирает текст из потока input. Поток читается по строкам по мере разбора,
+        // а разобранные строки удаляются из буфера лексера
+        explicit Lexer(std::istream& input, LexerThreading threading = LexerThreading::Inline);
+
+        // Разбирает текст source без копирования. Текст должен существовать, пока используется лексер
+        explicit Lexer(std::string_view source);
+
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
+        ~Lexer();
+
+        // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
+        [[nodiscard]] const Token& CurrentToken() const;
+
+        // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
+        Token NextToken();
+
+        // Пропускает блок строк с отступом больше текущего, не разбирая их на токены,
+        // и возвращает его исходный текст. Текущим токеном должен быть Newline, после вызова
+        // текущим становится первый токен после блока. Если блок пуст или лексемы
+        // разбираются в отдельном потоке, выбрасывает LexerError
+        std::string SkipIndentedBlock();
+
+        // Возвращает true, если лексемы разбираются в отдельном потоке
+        [[nodiscard]] bool IsBackground() const {
+            return background_ != nullptr;
+        }
+
+        // Таблица символов, в которую лексер заносит имена и строковые константы
+        [[nodiscard]] const SymbolTable& GetSymbols() const;
+        SymbolTable& Symbols();
+
+        // Если текущий токен имеет тип T, метод возвращает его.
+        // В противном случае метод выбрасывает исключение LexerError
+        template <typename T>
+        T Expect() const {
+            using namespace std::literals;
+            if (token_.Is<T>()) {
+                return token_.As<T>();
+            }
+            else {
+                throw LexerError("Not implemented"s);
+            }
+        }
+
+        // Метод проверяет, что текущий токен имеет тип T, а сам токен содержит значение value.
+        // В противном случае метод выбрасывает исключение LexerError
+        template <typename T, typename U>
+        void Expect(const U& value) const {
+            using namespace std::literals;
+            if (!Matches<T>(value)) {
+                throw LexerError("Not implemented"s);
+            }
+        }
+
+        // Если следующий токен имеет тип T, метод возвращает его.
+        // В противном случае метод выбрасывает исключение LexerError
+        template <typename T>
+        T ExpectNext() {
+            using namespace std::literals;
+            NextToken();
+            if (token_.Is<T>()) {
+                return token_.As<T>();
+            }
+            else {
+                throw LexerError("Not implemented"s);
+            }
+        }
+
+        // Метод проверяет, что следующий токен имеет тип T, а сам токен содержит значение value.
+        // В противном случае метод выбрасывает исключение LexerError
+        template <typename T, typename U>
+        void ExpectNext(const U& value) {
+            using namespace std::literals;
+            NextToken();
+            if (!Matches<T>(value)) {
+                throw LexerError("Not implemented"s);
+            }
+        }
+
+
+
+    private:
+        // Проверяет, что текущий токен имеет тип T и значение value.
+        // Имена и строки можно сравнивать как с номером символа, так и с самой строкой
+        template <typename T, typename U>
+        [[nodiscard]] bool Matches(const U& value) const {
+            if (!token_.Is<T>()) {
+                return false;
+            }
+            if constexpr (std::is_same_v<decltype(T::value), Symbol>
+                          && std::is_convertible_v<const U&, std::string_view>) {
+                return GetSymbols().GetName(token_.As<T>().value) == std::string_view(value);
+            }
+            else {
+                return token_.As<T>().value == value;
+            }
+        }
+
+        // Пропускает пробельные символы внутри строки
+        void SkipSpaces();
+        // Пропускает комментарий до конца строки, не считывая сам символ '\n'
+        void SkipComment();
+        // Разбирает отступ в начале строки. Пустые строки и строки-комментарии пропускаются целиком.
+        // Возвращает true, если отступ изменился и в token_ записана лексема Indent или Dedent
+        bool LoadIndentation();
+        void LoadToken();
+        void LoadIds();
+        void LoadString();
+        void LoadLogicSimbol();
+        // Дописывает в буфер следующую строку входного потока вместе с символом '\n'.
+        // Возвращает false, если поток закончился или лексер разбирает текст без потока
+        bool ReadLine();
+
+        // Лексер, разбирающий текст в отдельном потоке. Если он задан, остальные поля,
+        // кроме token_, не используются
+        class BackgroundLexer;
+        std::unique_ptr<BackgroundLexer> background_;
+
+        std::istream* input_ = nullptr;
+        std::string buffer_;
+        // Последняя прочитанная строка. Хранится в лексере, чтобы не выделять память для каждой строки
+        std::string line_;
+        std::string_view source_;
+        size_t pos_ = 0;
+        SymbolTable symbols_;
+        Token token_;
+        // Стек уровней отступа открытых блоков. На дне всегда лежит нулевой отступ
+        std::vector<size_t> indents_{0};
+        // Сколько лексем Dedent осталось выдать после выхода сразу из нескольких блоков
+        size_t pending_dedents_ = 0;
+        // Следующий символ - первый символ строки, перед ним нужно разобрать отступ
+        bool line_start_ = true;
+    };
+
+}  // namespace parse
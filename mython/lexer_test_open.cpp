@@ -1,372 +1,562 @@
-#include "lexer.h"
-#include "test_runner.h"
-
-#include <sstream>
-#include <string>
-
-using namespace std;
-
-namespace parse {
-
-namespace {
-void TestSimpleAssignment() {
-    istringstream input("x = 42\n"s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{42}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-}
-
-void TestKeywords() {
-    istringstream input("class return if else def print or None and not True False"s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Class{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Return{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::If{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Else{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Or{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::None{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::And{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Not{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::True{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::False{}));
-}
-
-void TestNumbers() {
-    istringstream input("42 15 -53"s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Number{42}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{15}));
-    // Отрицательные числа формируются на этапе синтаксического анализа
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'-'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{53}));
-}
-
-void TestIds() {
-    istringstream input("x    _42 big_number   Return Class  dEf"s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"_42"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"big_number"s}));
-    ASSERT_EQUAL(lexer.NextToken(),
-                 Token(token_type::Id{"Return"s}));  // keywords are case-sensitive
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"Class"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"dEf"s}));
-}
-
-void TestStrings() {
-    istringstream input(
-        R"('word' "two words" 'long string with a double quote " inside' "another long string with single quote ' inside")"s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::String{"word"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"two words"s}));
-    ASSERT_EQUAL(lexer.NextToken(),
-                 Token(token_type::String{"long string with a double quote \" inside"s}));
-    ASSERT_EQUAL(lexer.NextToken(),
-                 Token(token_type::String{"another long string with single quote ' inside"s}));
-}
-
-void TestOperations() {
-    istringstream input("+-*/= > < != == <> <= >="s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Char{'+'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'-'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'*'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'/'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'>'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'<'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::NotEq{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eq{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'<'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'>'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::LessOrEq{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::GreaterOrEq{}));
-}
-
-void TestIndentsAndNewlines() {
-    istringstream input(R"(
-no_indent
-  indent_one
-    indent_two
-      indent_three
-      indent_three
-      indent_three
-    indent_two
-  indent_one
-    indent_two
-no_indent
-)"s);
-
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"no_indent"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_one"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_two"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_three"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_three"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_three"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_two"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_one"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"indent_two"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"no_indent"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-}
-
-void TestEmptyLinesAreIgnored() {
-    istringstream input(R"(
-x = 1
-  y = 2
-
-  z = 3
-
-
-)"s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    // Пустая строка, состоящая только из пробельных символов не меняет текущий отступ,
-    // поэтому следующая лексема — это Id, а не Dedent
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"z"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{3}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-}
-
-void TestMythonProgram() {
-    istringstream input(R"(
-x = 4
-y = "hello"
-
-class Point:
-  def __init__(self, x, y):
-    self.x = x
-    self.y = y
-
-  def __str__(self):
-    return str(x) + ' ' + str(y)
-
-p = Point(1, 2)
-print str(p)
-)"s);
-    Lexer lexer(input);
-
-    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{4}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"hello"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Class{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"Point"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"__init__"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"self"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"self"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'.'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"self"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'.'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"__str__"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"self"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Return{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"str"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{" "s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"str"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"p"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"Point"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"str"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"p"s}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-}
-
-void TestExpect() {
-    istringstream is("bugaga"s);
-    Lexer lex(is);
-
-    ASSERT_DOESNT_THROW(lex.Expect<token_type::Id>());
-    ASSERT_EQUAL(lex.Expect<token_type::Id>().value, "bugaga"s);
-    ASSERT_DOESNT_THROW(lex.Expect<token_type::Id>("bugaga"s));
-    ASSERT_THROWS(lex.Expect<token_type::Id>("widget"s), LexerError);
-    ASSERT_THROWS(lex.Expect<token_type::Return>(), LexerError);
-}
-
-void TestExpectNext() {
-    istringstream is("+ bugaga + def 52"s);
-    Lexer lex(is);
-
-    ASSERT_EQUAL(lex.CurrentToken(), Token(token_type::Char{'+'}));
-    ASSERT_DOESNT_THROW(lex.ExpectNext<token_type::Id>());
-    ASSERT_DOESNT_THROW(lex.ExpectNext<token_type::Char>('+'));
-    ASSERT_THROWS(lex.ExpectNext<token_type::Newline>(), LexerError);
-    ASSERT_THROWS(lex.ExpectNext<token_type::Number>(57), LexerError);
-}
-
-void TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine() {
-    {
-        istringstream is("a b"s);
-        Lexer lexer(is);
-
-        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"a"s}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"b"s}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    }
-    {
-        istringstream is("+"s);
-        Lexer lexer(is);
-
-        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Char{'+'}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    }
-}
-void TestCommentsAreIgnored() {
-    {
-        istringstream is(R"(# comment
-)"s);
-        Lexer lexer(is);
-
-        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Eof{}));
-    }
-    {
-        istringstream is(R"(# comment
-
-)"s);
-        Lexer lexer(is);
-        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Eof{}));
-    }
-    {
-        istringstream is(R"(# comment
-x #another comment
-abc#
-'#'
-"#123"
-#)"s);
-
-        Lexer lexer(is);
-        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"abc"s}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"#"s}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"#123"s}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
-        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
-    }
-}
-}  // namespace
-
-void RunOpenLexerTests(TestRunner& tr) {
-    RUN_TEST(tr, parse::TestSimpleAssignment);
-    RUN_TEST(tr, parse::TestKeywords);
-    RUN_TEST(tr, parse::TestNumbers);
-    RUN_TEST(tr, parse::TestIds);
-    RUN_TEST(tr, parse::TestStrings);
-    RUN_TEST(tr, parse::TestOperations);
-    RUN_TEST(tr, parse::TestIndentsAndNewlines);
-    RUN_TEST(tr, parse::TestEmptyLinesAreIgnored);
-    RUN_TEST(tr, parse::TestExpect);
-    RUN_TEST(tr, parse::TestExpectNext);
-    RUN_TEST(tr, parse::TestMythonProgram);
-    RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
-    RUN_TEST(tr, parse::TestCommentsAreIgnored);
-}
-
-}  // namespace parse
+#include "lexer.h"
+#include "test_runner.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+Token IdToken(Lexer& lexer, string_view name) {
+    return token_type::Id{lexer.Symbols().Intern(name)};
+}
+
+Token StringToken(Lexer& lexer, string_view str) {
+    return token_type::String{lexer.Symbols().Intern(str)};
+}
+
+void TestSimpleAssignment() {
+    istringstream input("x = 42\n"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{42}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestKeywords() {
+    istringstream input("class return if else def print or None and not True False"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Class{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Return{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::If{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Else{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Or{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::None{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::And{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Not{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::True{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::False{}));
+}
+
+void TestNumbers() {
+    istringstream input("42 15 -53"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Number{42}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{15}));
+    // Отрицательные числа формируются на этапе синтаксического анализа
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'-'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{53}));
+}
+
+void TestIds() {
+    istringstream input("x    _42 big_number   Return Class  dEf"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "_42"s));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "big_number"s));
+    ASSERT_EQUAL(lexer.NextToken(),
+                 IdToken(lexer, "Return"s));  // keywords are case-sensitive
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "Class"s));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "dEf"s));
+}
+
+void TestStrings() {
+    istringstream input(
+        R"('word' "two words" 'long string with a double quote " inside' "another long string with single quote ' inside")"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), StringToken(lexer, "word"s));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken(lexer, "two words"s));
+    ASSERT_EQUAL(lexer.NextToken(),
+                 StringToken(lexer, "long string with a double quote \" inside"s));
+    ASSERT_EQUAL(lexer.NextToken(),
+                 StringToken(lexer, "another long string with single quote ' inside"s));
+}
+
+void TestOperations() {
+    istringstream input("+-*/= > < != == <> <= >="s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'-'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'*'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'/'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'>'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'<'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::NotEq{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eq{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'<'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'>'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::LessOrEq{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::GreaterOrEq{}));
+}
+
+void TestIndentsAndNewlines() {
+    istringstream input(R"(
+no_indent
+  indent_one
+    indent_two
+      indent_three
+      indent_three
+      indent_three
+    indent_two
+  indent_one
+    indent_two
+no_indent
+)"s);
+
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "no_indent"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_one"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_two"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_three"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_three"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_three"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_two"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_one"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "indent_two"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "no_indent"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestEmptyLinesAreIgnored() {
+    istringstream input(R"(
+x = 1
+  y = 2
+
+  z = 3
+
+
+)"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "y"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    // Пустая строка, состоящая только из пробельных символов не меняет текущий отступ,
+    // поэтому следующая лексема — это Id, а не Dedent
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "z"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{3}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestMythonProgram() {
+    istringstream input(R"(
+x = 4
+y = "hello"
+
+class Point:
+  def __init__(self, x, y):
+    self.x = x
+    self.y = y
+
+  def __str__(self):
+    return str(x) + ' ' + str(y)
+
+p = Point(1, 2)
+print str(p)
+)"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{4}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "y"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken(lexer, "hello"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Class{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "Point"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "__init__"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "self"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "y"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "self"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'.'}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "self"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'.'}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "y"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "y"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "__str__"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "self"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Return{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "str"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), StringToken(lexer, " "s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "str"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "y"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "p"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "Point"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "str"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "p"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestExpect() {
+    istringstream is("bugaga"s);
+    Lexer lex(is);
+
+    ASSERT_DOESNT_THROW(lex.Expect<token_type::Id>());
+    ASSERT_EQUAL(lex.GetSymbols().GetName(lex.Expect<token_type::Id>().value), "bugaga"s);
+    ASSERT_DOESNT_THROW(lex.Expect<token_type::Id>("bugaga"s));
+    ASSERT_THROWS(lex.Expect<token_type::Id>("widget"s), LexerError);
+    ASSERT_THROWS(lex.Expect<token_type::Return>(), LexerError);
+}
+
+void TestExpectNext() {
+    istringstream is("+ bugaga + def 52"s);
+    Lexer lex(is);
+
+    ASSERT_EQUAL(lex.CurrentToken(), Token(token_type::Char{'+'}));
+    ASSERT_DOESNT_THROW(lex.ExpectNext<token_type::Id>());
+    ASSERT_DOESNT_THROW(lex.ExpectNext<token_type::Char>('+'));
+    ASSERT_THROWS(lex.ExpectNext<token_type::Newline>(), LexerError);
+    ASSERT_THROWS(lex.ExpectNext<token_type::Number>(57), LexerError);
+}
+
+void TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine() {
+    {
+        istringstream is("a b"s);
+        Lexer lexer(is);
+
+        ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "a"s));
+        ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "b"s));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    }
+    {
+        istringstream is("+"s);
+        Lexer lexer(is);
+
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Char{'+'}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    }
+}
+void TestCommentsAreIgnored() {
+    {
+        istringstream is(R"(# comment
+)"s);
+        Lexer lexer(is);
+
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Eof{}));
+    }
+    {
+        istringstream is(R"(# comment
+
+)"s);
+        Lexer lexer(is);
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Eof{}));
+    }
+    {
+        istringstream is(R"(# comment
+x #another comment
+abc#
+'#'
+"#123"
+#)"s);
+
+        Lexer lexer(is);
+        ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "x"s));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "abc"s));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), StringToken(lexer, "#"s));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), StringToken(lexer, "#123"s));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    }
+}
+
+void TestNamesAreInterned() {
+    const string source = "name = 'name' + 'esc\\'aped'\nprint name, other\n"s;
+    Lexer lexer{string_view(source)};
+
+    const auto name = lexer.CurrentToken().As<token_type::Id>().value;
+    ASSERT_EQUAL(lexer.GetSymbols().GetName(name), "name"s);
+    ASSERT_EQUAL(sizeof(Token), 8u);
+
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    // Строка с тем же текстом, что и имя, получает тот же номер
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{name}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    const auto escaped = lexer.NextToken().As<token_type::String>().value;
+    ASSERT_EQUAL(lexer.GetSymbols().GetName(escaped), "esc'aped"s);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{name}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "other"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.GetSymbols().GetSize(), 3u);
+}
+
+void TestKeywordLookalikesAreIds() {
+    istringstream input("iff orr define ands nota elses Nones Truth classes printer False_ returns Class 007"s);
+    Lexer lexer(input);
+
+    for (const auto* name : {"iff", "orr", "define", "ands", "nota", "elses", "Nones", "Truth", "classes",
+                             "printer", "False_", "returns", "Class"}) {
+        ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, name));
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Number{7}));
+
+    istringstream too_large("x = 99999999999\n"s);
+    try {
+        Lexer failing(too_large);
+        for (int i = 0; i < 3; ++i) {
+            failing.NextToken();
+        }
+        ASSERT(false);
+    } catch (const LexerError&) {
+    }
+}
+
+void TestLongRunsOfBlankLinesAndComments() {
+    string source = "x = 1\n"s;
+    for (int i = 0; i < 200000; ++i) {
+        source += (i % 2 == 0) ? "# comment\n"s : "   \n"s;
+    }
+    source += "if x:\n  if x:\n    if x:\n      y = 2\n"s;
+    for (int i = 0; i < 200000; ++i) {
+        source += "      #\n"s;
+    }
+    source += "z = 3"s;
+    Lexer lexer{string_view(source)};
+
+    ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "x"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    for (int i = 0; i < 3; ++i) {
+        if (i > 0) {
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+        }
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::If{}));
+        ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "x"s));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    }
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "y"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), IdToken(lexer, "z"s));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{3}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestInconsistentDedentIsAnError() {
+    istringstream input("if x:\n    y = 1\n  z = 2\n"s);
+    Lexer lexer(input);
+
+    for (int i = 0; i < 5; ++i) {
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(lexer.CurrentToken(), IdToken(lexer, "y"s));
+    for (int i = 0; i < 3; ++i) {
+        lexer.NextToken();
+    }
+    ASSERT_THROWS(lexer.NextToken(), LexerError);
+}
+
+void TestBackgroundLexerMatchesInline() {
+    string program;
+    for (int i = 0; i < 3000; ++i) {
+        program += "class C"s + to_string(i) + ":\n  def m(x):\n    return x + 'str' * "s + to_string(i) + "\n"s;
+    }
+    // Последняя строка с неверным отступом
+    program += "   if x:\n"s;
+
+    istringstream inline_input(program);
+    Lexer inline_lexer(inline_input);
+    istringstream background_input(program);
+    Lexer background_lexer(background_input, LexerThreading::Background);
+    ASSERT(background_lexer.IsBackground());
+
+    size_t count = 0;
+    while (true) {
+        const Token& token = inline_lexer.CurrentToken();
+        ASSERT(background_lexer.CurrentToken().GetKind() == token.GetKind());
+        if (token.Is<token_type::Id>() || token.Is<token_type::String>()) {
+            ASSERT_EQUAL(background_lexer.GetSymbols().GetName(background_lexer.CurrentToken().GetPayload()),
+                         inline_lexer.GetSymbols().GetName(token.GetPayload()));
+        }
+        else {
+            ASSERT_EQUAL(background_lexer.CurrentToken(), token);
+        }
+        ++count;
+
+        bool failed = false;
+        try {
+            inline_lexer.NextToken();
+        }
+        catch (const LexerError&) {
+            failed = true;
+        }
+        if (failed) {
+            // Ошибка выбрасывается на той же лексеме
+            ASSERT_THROWS(background_lexer.NextToken(), LexerError);
+            break;
+        }
+        background_lexer.NextToken();
+    }
+    ASSERT(count > 3000 * 20);
+
+    // Лексер можно уничтожить, не дочитав лексемы из заполненного буфера
+    istringstream unread_input(program);
+    Lexer unread_lexer(unread_input, LexerThreading::Background);
+    ASSERT_EQUAL(unread_lexer.CurrentToken(), Token(token_type::Class{}));
+}
+
+void TestBackgroundLexerWaitsForConsumer() {
+    string program;
+    for (int i = 0; i < 3000; ++i) {
+        program += "x = y + "s + to_string(i) + "\n"s;
+    }
+
+    // Пока потребитель не читает лексемы, производитель заполняет буфер и засыпает.
+    // Он просыпается, когда в буфере появляется место, и когда лексер уничтожается
+    istringstream input(program);
+    Lexer lexer(input, LexerThreading::Background);
+    this_thread::sleep_for(chrono::milliseconds(20));
+    size_t count = 1;
+    while (!lexer.CurrentToken().Is<token_type::Eof>()) {
+        lexer.NextToken();
+        ++count;
+    }
+    ASSERT_EQUAL(count, 3000U * 6 + 1);
+
+    istringstream unread_input(program);
+    {
+        Lexer unread_lexer(unread_input, LexerThreading::Background);
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+}
+}  // namespace
+
+void RunOpenLexerTests(TestRunner& tr) {
+    RUN_TEST(tr, parse::TestSimpleAssignment);
+    RUN_TEST(tr, parse::TestKeywords);
+    RUN_TEST(tr, parse::TestNumbers);
+    RUN_TEST(tr, parse::TestIds);
+    RUN_TEST(tr, parse::TestStrings);
+    RUN_TEST(tr, parse::TestOperations);
+    RUN_TEST(tr, parse::TestIndentsAndNewlines);
+    RUN_TEST(tr, parse::TestEmptyLinesAreIgnored);
+    RUN_TEST(tr, parse::TestExpect);
+    RUN_TEST(tr, parse::TestExpectNext);
+    RUN_TEST(tr, parse::TestMythonProgram);
+    RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
+    RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestNamesAreInterned);
+    RUN_TEST(tr, parse::TestKeywordLookalikesAreIds);
+    RUN_TEST(tr, parse::TestLongRunsOfBlankLinesAndComments);
+    RUN_TEST(tr, parse::TestInconsistentDedentIsAnError);
+    RUN_TEST(tr, parse::TestBackgroundLexerMatchesInline);
+    RUN_TEST(tr, parse::TestBackgroundLexerWaitsForConsumer);
+}
+
+}  // namespace parse
@@ -1,140 +1,235 @@
-#include "lexer.h"
-#include "parse.h"
-#include "runtime.h"
-#include "statement.h"
-#include "test_runner.h"
-
-#include <iostream>
-
-using namespace std;
-
-namespace parse {
-void RunOpenLexerTests(TestRunner& tr);
-}  // namespace parse
-
-namespace ast {
-void RunUnitTests(TestRunner& tr);
-}
-namespace runtime {
-void RunObjectHolderTests(TestRunner& tr);
-void RunObjectsTests(TestRunner& tr);
-}  // namespace runtime
-
-void TestParseProgram(TestRunner& tr);
-
-namespace {
-
-void RunMythonProgram(istream& input, ostream& output) {
-    parse::Lexer lexer(input);
-    auto program = ParseProgram(lexer);
-
-    runtime::SimpleContext context{output};
-    runtime::Closure closure;
-    program->Execute(closure, context);
-}
-
-void TestSimplePrints() {
-    istringstream input(R"(
-print 57
-print 10, 24, -8
-print 'hello'
-print "world"
-print True, False
-print
-print None
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "57\n10 24 -8\nhello\nworld\nTrue False\n\nNone\n");
-}
-
-void TestAssignments() {
-    istringstream input(R"(
-x = 57
-print x
-x = 'C++ black belt'
-print x
-y = False
-x = y
-print x
-x = None
-print x, y
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "57\nC++ black belt\nFalse\nNone False\n");
-}
-
-void TestArithmetics() {
-    istringstream input("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
-}
-
-void TestVariablesArePointers() {
-    istringstream input(R"(
-class Counter:
-  def __init__():
-    self.value = 0
-
-  def add():
-    self.value = self.value + 1
-
-class Dummy:
-  def do_add(counter):
-    counter.add()
-
-x = Counter()
-y = x
-
-x.add()
-y.add()
-
-print x.value
-
-d = Dummy()
-d.do_add(x)
-
-print y.value
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "2\n3\n");
-}
-
-void TestAll() {
-    TestRunner tr;
-    parse::RunOpenLexerTests(tr);
-    runtime::RunObjectHolderTests(tr);
-    runtime::RunObjectsTests(tr);
-    ast::RunUnitTests(tr);
-    TestParseProgram(tr);
-
-    RUN_TEST(tr, TestSimplePrints);
-    RUN_TEST(tr, TestAssignments);
-    RUN_TEST(tr, TestArithmetics);
-    RUN_TEST(tr, TestVariablesArePointers);
-}
-
-}  // namespace
-
-int main() {
-    try {
-        TestAll();
-
-        RunMythonProgram(cin, cout);
-    } catch (const std::exception& e) {
-        std::cerr << e.what() << std::endl;
-		return 1;
-    }
-    return 0;
-}
+#include "bytecode.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "serialize.h"
+#include "statement.h"
+#include "test_runner.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+
+namespace parse {
+void RunOpenLexerTests(TestRunner& tr);
+}  // namespace parse
+
+namespace ast {
+void RunUnitTests(TestRunner& tr);
+}
+namespace bytecode {
+void RunBytecodeTests(TestRunner& tr);
+}
+namespace runtime {
+void RunObjectHolderTests(TestRunner& tr);
+void RunObjectsTests(TestRunner& tr);
+}  // namespace runtime
+
+void TestParseProgram(TestRunner& tr);
+
+namespace {
+
+// Исполняет программу из потока input. Если задан cache, разобранная программа
+// берётся из кэша либо сохраняется в нём. Без кэша инструкции верхнего уровня исполняются
+// по мере разбора, поэтому вывод появляется до того, как прочитан весь вход.
+// Если parse_threads больше 1, программа читается целиком и её классы разбираются параллельно.
+// Ленивый разбор тел методов (method_parsing) не применяется при чтении из кэша и с лексером
+// в отдельном потоке, поэтому синтаксические ошибки в телах невызываемых методов обнаруживаются
+// во всех режимах одинаково, только если тела разбираются сразу
+void RunMythonProgram(istream& input, ostream& output, ast::ProgramCache* cache = nullptr,
+                      parse::LexerThreading threading = parse::LexerThreading::Inline,
+                      size_t parse_threads = 1, MethodParsing method_parsing = MethodParsing::Eager) {
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    if (cache || parse_threads > 1) {
+        const string source{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+        auto tree = cache ? cache->Load(source)
+                          : ParseProgramInParallel(source, parse_threads, method_parsing);
+        bytecode::Compile(std::move(tree))->Execute(closure, context);
+        return;
+    }
+
+    parse::Lexer lexer(input, threading);
+    auto machine = make_shared<bytecode::VirtualMachine>();
+    ParseProgram(
+        lexer,
+        [&](unique_ptr<runtime::Executable> statement) {
+            bytecode::Compile(std::move(statement), machine)->Execute(closure, context);
+        },
+        method_parsing);
+}
+
+void TestSimplePrints() {
+    istringstream input(R"(
+print 57
+print 10, 24, -8
+print 'hello'
+print "world"
+print True, False
+print
+print None
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "57\n10 24 -8\nhello\nworld\nTrue False\n\nNone\n");
+}
+
+void TestAssignments() {
+    istringstream input(R"(
+x = 57
+print x
+x = 'C++ black belt'
+print x
+y = False
+x = y
+print x
+x = None
+print x, y
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "57\nC++ black belt\nFalse\nNone False\n");
+}
+
+void TestArithmetics() {
+    istringstream input("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
+}
+
+void TestVariablesArePointers() {
+    istringstream input(R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+
+class Dummy:
+  def do_add(counter):
+    counter.add()
+
+x = Counter()
+y = x
+
+x.add()
+y.add()
+
+print x.value
+
+d = Dummy()
+d.do_add(x)
+
+print y.value
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "2\n3\n");
+}
+
+void TestStatementsRunAsTheyAreParsed() {
+    istringstream input(R"(
+class Greeter:
+  def greet(name):
+    return 'hello, ' + name
+
+g = Greeter()
+print g.greet('world')
+x = 'streaming
+ works'
+print x
+print 1 +
+print 'unreachable'
+)");
+
+    ostringstream output;
+    try {
+        RunMythonProgram(input, output);
+        ASSERT(false);
+    }
+    catch (const parse::LexerError&) {
+    }
+    ASSERT_EQUAL(output.str(), "hello, world\nstreaming works\n"s);
+}
+
+void TestMethodBodiesAreCheckedInEveryMode() {
+    const string program = R"(
+class Broken:
+  def never_called():
+    return 1 +
+
+print 5
+)"s;
+
+    for (size_t parse_threads : {1, 2}) {
+        istringstream input(program);
+        ostringstream output;
+        ASSERT_THROWS(RunMythonProgram(input, output, nullptr, parse::LexerThreading::Inline, parse_threads),
+                      parse::LexerError);
+        ASSERT_EQUAL(output.str(), ""s);
+    }
+}
+
+void TestAll() {
+    TestRunner tr;
+    parse::RunOpenLexerTests(tr);
+    runtime::RunObjectHolderTests(tr);
+    runtime::RunObjectsTests(tr);
+    ast::RunUnitTests(tr);
+    TestParseProgram(tr);
+    bytecode::RunBytecodeTests(tr);
+
+    RUN_TEST(tr, TestSimplePrints);
+    RUN_TEST(tr, TestAssignments);
+    RUN_TEST(tr, TestArithmetics);
+    RUN_TEST(tr, TestVariablesArePointers);
+    RUN_TEST(tr, TestStatementsRunAsTheyAreParsed);
+    RUN_TEST(tr, TestMethodBodiesAreCheckedInEveryMode);
+}
+
+}  // namespace
+
+int main() {
+    try {
+        TestAll();
+
+        // Тела методов разбираются при первом вызове, только если задана MYTHON_LAZY_METHODS
+        const auto method_parsing = std::getenv("MYTHON_LAZY_METHODS") ? MethodParsing::Lazy
+                                                                       : MethodParsing::Eager;
+
+        // Каталог кэша разобранных программ задаётся переменной окружения MYTHON_CACHE_DIR
+        if (const char* cache_dir = std::getenv("MYTHON_CACHE_DIR")) {
+            ast::ProgramCache cache(cache_dir);
+            RunMythonProgram(cin, cout, &cache);
+        }
+        // MYTHON_PARSE_THREADS задаёт число потоков для параллельного разбора классов
+        else if (const char* parse_threads = std::getenv("MYTHON_PARSE_THREADS")) {
+            RunMythonProgram(cin, cout, nullptr, parse::LexerThreading::Inline,
+                             static_cast<size_t>(std::max(std::atoi(parse_threads), 1)), method_parsing);
+        }
+        // Если задана переменная окружения MYTHON_LEXER_THREAD, лексер работает в отдельном потоке
+        else if (std::getenv("MYTHON_LEXER_THREAD")) {
+            RunMythonProgram(cin, cout, nullptr, parse::LexerThreading::Background);
+        }
+        else {
+            RunMythonProgram(cin, cout, nullptr, parse::LexerThreading::Inline, 1, method_parsing);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+		return 1;
+    }
+    return 0;
+}
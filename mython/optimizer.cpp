@@ -0,0 +1,172 @@
+#include "optimizer.h"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+    namespace {
+
+        bool IsConstant(const Statement& stmt) {
+            return dynamic_cast<const NumericConst*>(&stmt) || dynamic_cast<const StringConst*>(&stmt)
+                || dynamic_cast<const BoolConst*>(&stmt) || dynamic_cast<const None*>(&stmt);
+        }
+
+        // Вычисляет выражение над константами. Возвращает nullptr, если вычисление
+        // завершилось ошибкой либо дало значение, не представимое константой
+        unique_ptr<Statement> Evaluate(Statement& stmt) {
+            runtime::Closure closure;
+            runtime::DummyContext context;
+            runtime::ObjectHolder value;
+            try {
+                value = stmt.Execute(closure, context);
+            }
+            catch (const runtime_error&) {
+                return nullptr;
+            }
+            switch (value.GetKind()) {
+            case runtime::ObjectKind::None:
+                return make_unique<None>();
+            case runtime::ObjectKind::Number:
+                return make_unique<NumericConst>(*value.TryAs<runtime::Number>());
+            case runtime::ObjectKind::String:
+                return make_unique<StringConst>(*value.TryAs<runtime::String>());
+            case runtime::ObjectKind::Bool:
+                return make_unique<BoolConst>(*value.TryAs<runtime::Bool>());
+            default:
+                return nullptr;
+            }
+        }
+
+        // Возвращает true, если в stmt объявлен класс. Классом владеет узел ClassDefinition,
+        // а узлы NewInstance ссылаются на класс напрямую, поэтому ветвь с объявлением
+        // класса нельзя удалять, даже если она никогда не выполняется
+        bool DefinesClass(Statement* stmt) {
+            if (stmt == nullptr) {
+                return false;
+            }
+            if (dynamic_cast<ClassDefinition*>(stmt)) {
+                return true;
+            }
+            if (auto* if_else = dynamic_cast<IfElse*>(stmt)) {
+                return DefinesClass(if_else->IfBody().get()) || DefinesClass(if_else->ElseBody().get());
+            }
+            if (auto* compound = dynamic_cast<Compound*>(stmt)) {
+                for (auto& child : compound->Statements()) {
+                    if (DefinesClass(child.get())) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void Fold(unique_ptr<Statement>& stmt);
+
+        void FoldAll(vector<unique_ptr<Statement>>& statements) {
+            for (auto& stmt : statements) {
+                Fold(stmt);
+            }
+        }
+
+        void FoldClass(const runtime::ObjectHolder& cls) {
+            for (auto& method : cls.TryAs<runtime::Class>()->Methods()) {
+                if (auto* body = dynamic_cast<MethodBody*>(method.body.get())) {
+                    Fold(body->Body());
+                }
+            }
+        }
+
+        // Заменяет stmt константой, если все операнды уже свёрнуты в константы
+        void FoldOperation(unique_ptr<Statement>& stmt, std::initializer_list<const Statement*> operands) {
+            for (const Statement* operand : operands) {
+                if (!IsConstant(*operand)) {
+                    return;
+                }
+            }
+            if (auto folded = Evaluate(*stmt)) {
+                stmt = std::move(folded);
+            }
+        }
+
+        void Fold(unique_ptr<Statement>& stmt) {
+            if (auto* binary = dynamic_cast<BinaryOperation*>(stmt.get())) {
+                Fold(binary->Lhs());
+                Fold(binary->Rhs());
+                FoldOperation(stmt, {binary->Lhs().get(), binary->Rhs().get()});
+            }
+            else if (auto* unary = dynamic_cast<UnaryOperation*>(stmt.get())) {
+                Fold(unary->Argument());
+                FoldOperation(stmt, {unary->Argument().get()});
+            }
+            else if (auto* if_else = dynamic_cast<IfElse*>(stmt.get())) {
+                Fold(if_else->Condition());
+                Fold(if_else->IfBody());
+                if (if_else->ElseBody()) {
+                    Fold(if_else->ElseBody());
+                }
+                if (IsConstant(*if_else->Condition()) && !DefinesClass(if_else->IfBody().get())
+                    && !DefinesClass(if_else->ElseBody().get())) {
+                    runtime::Closure closure;
+                    runtime::DummyContext context;
+                    if (runtime::IsTrue(if_else->Condition()->Execute(closure, context))) {
+                        stmt = std::move(if_else->IfBody());
+                    }
+                    else if (if_else->ElseBody()) {
+                        stmt = std::move(if_else->ElseBody());
+                    }
+                    else {
+                        stmt = make_unique<Compound>();
+                    }
+                }
+            }
+            else if (auto* compound = dynamic_cast<Compound*>(stmt.get())) {
+                // Вложенные блоки, оставшиеся от удалённых ветвей if, встраиваются в объемлющий
+                vector<unique_ptr<Statement>> statements;
+                for (auto& child : compound->Statements()) {
+                    Fold(child);
+                    if (auto* nested = dynamic_cast<Compound*>(child.get())) {
+                        for (auto& nested_child : nested->Statements()) {
+                            statements.push_back(std::move(nested_child));
+                        }
+                    }
+                    else {
+                        statements.push_back(std::move(child));
+                    }
+                }
+                compound->Statements() = std::move(statements);
+            }
+            else if (auto* assignment = dynamic_cast<Assignment*>(stmt.get())) {
+                Fold(assignment->RightValue());
+            }
+            else if (auto* field_assignment = dynamic_cast<FieldAssignment*>(stmt.get())) {
+                Fold(field_assignment->RightValue());
+            }
+            else if (auto* print = dynamic_cast<Print*>(stmt.get())) {
+                FoldAll(print->Args());
+            }
+            else if (auto* call = dynamic_cast<MethodCall*>(stmt.get())) {
+                Fold(call->Object());
+                FoldAll(call->Args());
+            }
+            else if (auto* instance = dynamic_cast<NewInstance*>(stmt.get())) {
+                FoldAll(instance->Args());
+            }
+            else if (auto* ret = dynamic_cast<Return*>(stmt.get())) {
+                Fold(ret->ReturnValue());
+            }
+            else if (auto* definition = dynamic_cast<ClassDefinition*>(stmt.get())) {
+                FoldClass(definition->GetClass());
+            }
+        }
+
+    }  // namespace
+
+    void FoldConstants(unique_ptr<Statement>& program) {
+        Fold(program);
+    }
+
+}  // namespace ast
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "statement.h"
+
+#include <memory>
+
+namespace ast {
+
+    /*
+     * Сворачивает константные подвыражения программы program, включая тела методов
+     * объявленных в ней классов. Арифметика, сравнения, логические операции и str()
+     * над константами заменяются одной константой, ветви if с константным условием -
+     * выбранной ветвью. Выражения, вычисление которых завершается ошибкой
+     * (например, деление на ноль), остаются в дереве, чтобы ошибка возникла при выполнении
+     */
+    void FoldConstants(std::unique_ptr<Statement>& program);
+
+}  // namespace ast
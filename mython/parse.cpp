@@ -1,448 +1,830 @@
-#include "parse.h"
-
-#include "lexer.h"
-#include "statement.h"
-
-using namespace std;
-
-namespace TokenType = parse::token_type;
-
-namespace {
-bool operator==(const parse::Token& token, char c) {
-    const auto* p = token.TryAs<TokenType::Char>();
-    return p != nullptr && p->value == c;
-}
-
-bool operator!=(const parse::Token& token, char c) {
-    return !(token == c);
-}
-
-class Parser {
-public:
-    explicit Parser(parse::Lexer& lexer)
-        : lexer_(lexer) {
-    }
-
-    // Program -> eps
-    //          | Statement \n Program
-    unique_ptr<ast::Statement> ParseProgram() {
-        auto result = make_unique<ast::Compound>();
-        while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
-            result->AddStatement(ParseStatement());
-        }
-
-        return result;
-    }
-
-private:
-    // Suite -> NEWLINE INDENT (Statement)+ DEDENT
-    unique_ptr<ast::Statement> ParseSuite()  // NOLINT
-    {
-        lexer_.Expect<TokenType::Newline>();
-        lexer_.ExpectNext<TokenType::Indent>();
-
-        lexer_.NextToken();
-
-        auto result = make_unique<ast::Compound>();
-        while (!lexer_.CurrentToken().Is<TokenType::Dedent>()) {
-            result->AddStatement(ParseStatement());  // NOLINT
-        }
-
-        lexer_.Expect<TokenType::Dedent>();
-        lexer_.NextToken();
-
-        return result;
-    }
-
-    // Methods -> [def id(Params) : Suite]*
-    vector<runtime::Method> ParseMethods()  // NOLINT
-    {
-        vector<runtime::Method> result;
-
-        while (lexer_.CurrentToken().Is<TokenType::Def>()) {
-            runtime::Method m;
-
-            m.name = lexer_.ExpectNext<TokenType::Id>().value;
-            lexer_.ExpectNext<TokenType::Char>('(');
-
-            if (lexer_.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(lexer_.Expect<TokenType::Id>().value);
-                while (lexer_.NextToken() == ',') {
-                    m.formal_params.push_back(lexer_.ExpectNext<TokenType::Id>().value);
-                }
-            }
-
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.ExpectNext<TokenType::Char>(':');
-            lexer_.NextToken();
-
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
-
-            result.push_back(std::move(m));
-        }
-        return result;
-    }
-
-    // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
-    unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
-    {
-        string class_name = lexer_.Expect<TokenType::Id>().value;
-
-        lexer_.NextToken();
-
-        const runtime::Class* base_class = nullptr;
-        if (lexer_.CurrentToken() == '(') {
-            auto name = lexer_.ExpectNext<TokenType::Id>().value;
-            lexer_.ExpectNext<TokenType::Char>(')');
-            lexer_.NextToken();
-
-            auto it = declared_classes_.find(name);
-            if (it == declared_classes_.end()) {
-                throw ParseError("Base class "s + name + " not found for class "s + class_name);
-            }
-            base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
-        }
-
-        lexer_.Expect<TokenType::Char>(':');
-        lexer_.ExpectNext<TokenType::Newline>();
-        lexer_.ExpectNext<TokenType::Indent>();
-        lexer_.ExpectNext<TokenType::Def>();
-        vector<runtime::Method> methods = ParseMethods();  // NOLINT
-
-        lexer_.Expect<TokenType::Dedent>();
-        lexer_.NextToken();
-
-        auto [it, inserted] = declared_classes_.insert({
-            class_name,
-            runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class)),
-        });
-
-        if (!inserted) {
-            throw ParseError("Class "s + class_name + " already exists"s);
-        }
-
-        return make_unique<ast::ClassDefinition>(it->second);
-    }
-
-    vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
-
-        while (lexer_.NextToken() == '.') {
-            result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
-        }
-
-        return result;
-    }
-
-    //  AssgnOrCall -> DottedIds = Expr
-    //               | DottedIds '(' ExprList ')'
-    unique_ptr<ast::Statement> ParseAssignmentOrCall() {
-        lexer_.Expect<TokenType::Id>();
-
-        vector<string> id_list = ParseDottedIds();
-        string last_name = id_list.back();
-        id_list.pop_back();
-
-        if (lexer_.CurrentToken() == '=') {
-            lexer_.NextToken();
-
-            if (id_list.empty()) {
-                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
-            }
-            return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
-                                                     std::move(last_name), ParseTest());
-        }
-        lexer_.Expect<TokenType::Char>('(');
-        lexer_.NextToken();
-
-        if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
-        }
-
-        vector<unique_ptr<ast::Statement>> args;
-        if (lexer_.CurrentToken() != ')') {
-            args = ParseTestList();
-        }
-        lexer_.Expect<TokenType::Char>(')');
-        lexer_.NextToken();
-
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
-                                            std::move(last_name), std::move(args));
-    }
-
-    // Expr -> Adder ['+'/'-' Adder]*
-    unique_ptr<ast::Statement> ParseExpression()  // NOLINT
-    {
-        unique_ptr<ast::Statement> result = ParseAdder();
-        while (lexer_.CurrentToken() == '+' || lexer_.CurrentToken() == '-') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
-
-            if (op == '+') {
-                result = make_unique<ast::Add>(std::move(result), ParseAdder());
-            } else {
-                result = make_unique<ast::Sub>(std::move(result), ParseAdder());
-            }
-        }
-        return result;
-    }
-
-    // Adder -> Mult ['*'/'/' Mult]*
-    unique_ptr<ast::Statement> ParseAdder()  // NOLINT
-    {
-        unique_ptr<ast::Statement> result = ParseMult();
-        while (lexer_.CurrentToken() == '*' || lexer_.CurrentToken() == '/') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
-
-            if (op == '*') {
-                result = make_unique<ast::Mult>(std::move(result), ParseMult());
-            } else {
-                result = make_unique<ast::Div>(std::move(result), ParseMult());
-            }
-        }
-        return result;
-    }
-
-    // Mult -> '(' Expr ')'
-    //       | NUMBER
-    //       | '-' Mult
-    //       | STRING
-    //       | NONE
-    //       | TRUE
-    //       | FALSE
-    //       | DottedIds '(' ExprList ')'
-    //       | DottedIds
-    unique_ptr<ast::Statement> ParseMult()  // NOLINT
-    {
-        if (lexer_.CurrentToken() == '(') {
-            lexer_.NextToken();
-            auto result = ParseTest();
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.NextToken();
-            return result;
-        }
-        if (lexer_.CurrentToken() == '-') {
-            lexer_.NextToken();
-            return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
-        }
-        if (const auto* num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
-            int result = num->value;
-            lexer_.NextToken();
-            return make_unique<ast::NumericConst>(result);
-        }
-        if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-            string result = str->value;
-            lexer_.NextToken();
-            return make_unique<ast::StringConst>(std::move(result));
-        }
-        if (lexer_.CurrentToken().Is<TokenType::True>()) {
-            lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(true));
-        }
-        if (lexer_.CurrentToken().Is<TokenType::False>()) {
-            lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(false));
-        }
-        if (lexer_.CurrentToken().Is<TokenType::None>()) {
-            lexer_.NextToken();
-            return make_unique<ast::None>();
-        }
-
-        return ParseDottedIdsInMultExpr();
-    }
-
-    std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-        vector<string> names = ParseDottedIds();
-
-        if (lexer_.CurrentToken() == '(') {
-            // various calls
-            vector<unique_ptr<ast::Statement>> args;
-            if (lexer_.NextToken() != ')') {
-                args = ParseTestList();
-            }
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.NextToken();
-
-            auto method_name = names.back();
-            names.pop_back();
-
-            if (!names.empty()) {
-                return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
-                    std::move(args));
-            }
-            if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
-                return make_unique<ast::NewInstance>(
-                    static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
-            }
-            if (method_name == "str"sv) {
-                if (args.size() != 1) {
-                    throw ParseError("Function str takes exactly one argument"s);
-                }
-                return make_unique<ast::Stringify>(std::move(args.front()));
-            }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
-        }
-        return make_unique<ast::VariableValue>(std::move(names));
-    }
-
-    vector<unique_ptr<ast::Statement>> ParseTestList()  // NOLINT
-    {
-        vector<unique_ptr<ast::Statement>> result;
-        result.push_back(ParseTest());
-
-        while (lexer_.CurrentToken() == ',') {
-            lexer_.NextToken();
-            result.push_back(ParseTest());
-        }
-        return result;
-    }
-
-    // Condition -> if LogicalExpr: Suite [else: Suite]
-    unique_ptr<ast::Statement> ParseCondition()  // NOLINT
-    {
-        lexer_.Expect<TokenType::If>();
-        lexer_.NextToken();
-
-        auto condition = ParseTest();
-
-        lexer_.Expect<TokenType::Char>(':');
-        lexer_.NextToken();
-
-        auto if_body = ParseSuite();
-
-        unique_ptr<ast::Statement> else_body;
-        if (lexer_.CurrentToken().Is<TokenType::Else>()) {
-            lexer_.ExpectNext<TokenType::Char>(':');
-            lexer_.NextToken();
-            else_body = ParseSuite();
-        }
-
-        return make_unique<ast::IfElse>(std::move(condition), std::move(if_body),
-                                        std::move(else_body));
-    }
-
-    // LogicalExpr -> AndTest [OR AndTest]
-    // AndTest -> NotTest [AND NotTest]
-    // NotTest -> [NOT] NotTest
-    //          | Comparison
-    unique_ptr<ast::Statement> ParseTest()  // NOLINT
-    {
-        auto result = ParseAndTest();
-        while (lexer_.CurrentToken().Is<TokenType::Or>()) {
-            lexer_.NextToken();
-            result = make_unique<ast::Or>(std::move(result), ParseAndTest());
-        }
-        return result;
-    }
-
-    unique_ptr<ast::Statement> ParseAndTest()  // NOLINT
-    {
-        auto result = ParseNotTest();
-        while (lexer_.CurrentToken().Is<TokenType::And>()) {
-            lexer_.NextToken();
-            result = make_unique<ast::And>(std::move(result), ParseNotTest());
-        }
-        return result;
-    }
-
-    unique_ptr<ast::Statement> ParseNotTest()  // NOLINT
-    {
-        if (lexer_.CurrentToken().Is<TokenType::Not>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Not>(ParseNotTest());  // NOLINT
-        }
-        return ParseComparison();
-    }
-
-    // Comparison -> Expr [COMP_OP Expr]
-    unique_ptr<ast::Statement> ParseComparison()  // NOLINT
-    {
-        auto result = ParseExpression();
-
-        const auto tok = lexer_.CurrentToken();
-
-        if (tok == '<') {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok == '>') {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::Eq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::NotEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::LessOrEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::GreaterOrEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
-                                                ParseExpression());
-        }
-        return result;
-    }
-
-    // Statement -> SimpleStatement Newline
-    //           | class ClassDefinition
-    //           | if Condition
-    unique_ptr<ast::Statement> ParseStatement()  // NOLINT
-    {
-        const auto& tok = lexer_.CurrentToken();
-
-        if (tok.Is<TokenType::Class>()) {
-            lexer_.NextToken();
-            return ParseClassDefinition();  // NOLINT
-        }
-        if (tok.Is<TokenType::If>()) {
-            return ParseCondition();
-        }
-        auto result = ParseSimpleStatement();
-        lexer_.Expect<TokenType::Newline>();
-        lexer_.NextToken();
-        return result;
-    }
-
-    // StatementBody -> return Expression
-    //               | print ExpressionList
-    //               | AssignmentOrCall
-    unique_ptr<ast::Statement> ParseSimpleStatement() {
-        const auto& tok = lexer_.CurrentToken();
-
-        if (tok.Is<TokenType::Return>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Return>(ParseTest());
-        }
-        if (tok.Is<TokenType::Print>()) {
-            lexer_.NextToken();
-            vector<unique_ptr<ast::Statement>> args;
-            if (!lexer_.CurrentToken().Is<TokenType::Newline>()) {
-                args = ParseTestList();
-            }
-            return make_unique<ast::Print>(std::move(args));
-        }
-        return ParseAssignmentOrCall();
-    }
-
-    parse::Lexer& lexer_;
-    runtime::Closure declared_classes_;
-};
-
-}  // namespace
-
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
-}
+#include "parse.h"
+
+#include "arena.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "resolver.h"
+#include "statement.h"
+
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+namespace TokenType = parse::token_type;
+
+namespace {
+bool operator==(const parse::Token& token, char c) {
+    return token.Is<TokenType::Char>() && token.As<TokenType::Char>().value == c;
+}
+
+bool operator!=(const parse::Token& token, char c) {
+    return !(token == c);
+}
+
+/*
+ * Классы, объявленные в тексте, в порядке объявления. Текст, разобранный отдельно
+ * (тело метода при ленивом разборе или часть программы при параллельном разборе),
+ * получает свою область, которой видны первые parent_count классов внешней области.
+ * Ссылки на классы не владеющие: классами владеют узлы ClassDefinition
+ */
+class ClassScope {
+public:
+    explicit ClassScope(shared_ptr<const ClassScope> parent = nullptr, size_t parent_count = 0)
+        : parent_(std::move(parent))
+        , parent_count_(parent_count) {
+    }
+
+    void Add(const runtime::ObjectHolder& cls) {
+        const auto& name = cls.TryAs<runtime::Class>()->GetName();
+        index_.emplace(name, classes_.size());
+        classes_.push_back(runtime::ObjectHolder::Share(*cls));
+    }
+
+    // Ищет класс name среди первых count классов области и видимых ей классов внешних областей
+    [[nodiscard]] const runtime::ObjectHolder* Find(string_view name, size_t count) const {
+        if (const auto it = index_.find(name); it != index_.end() && it->second < count) {
+            return &classes_[it->second];
+        }
+        return parent_ ? parent_->Find(name, parent_count_) : nullptr;
+    }
+
+    [[nodiscard]] size_t GetSize() const {
+        return classes_.size();
+    }
+
+private:
+    shared_ptr<const ClassScope> parent_;
+    size_t parent_count_;
+    vector<runtime::ObjectHolder> classes_;
+    // Ключи ссылаются на имена объектов классов
+    unordered_map<string_view, size_t> index_;
+};
+
+// Класс, объект которого создан до разбора его объявления. Методы и родитель
+// задаются ему после разбора, при связывании классов в порядке объявления
+struct PredeclaredClass {
+    runtime::ObjectHolder cls;
+    vector<runtime::Method> methods;
+    const runtime::Class* parent = nullptr;
+};
+
+class Parser {
+public:
+    explicit Parser(parse::Lexer& lexer, MethodParsing method_parsing = MethodParsing::Eager,
+                    shared_ptr<const ClassScope> outer_scope = nullptr, size_t outer_count = 0,
+                    PredeclaredClass* predeclared = nullptr)
+        : lexer_(lexer)
+        , str_symbol_(lexer.Symbols().Intern("str"sv))
+        , method_parsing_(method_parsing)
+        , scope_(make_shared<ClassScope>(std::move(outer_scope), outer_count))
+        , predeclared_(predeclared) {
+    }
+
+    // Program -> eps
+    //          | Statement \n Program
+    unique_ptr<ast::Statement> ParseProgram() {
+        auto result = make_unique<ast::Compound>();
+        while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
+            result->AddStatement(ParseStatement());
+        }
+
+        return result;
+    }
+
+    // Разбирает очередную инструкцию программы. В конце программы возвращает nullptr.
+    // Простая инструкция разбирается только до конца своей строки: следующая строка
+    // читается при разборе следующей инструкции
+    unique_ptr<ast::Statement> ParseNextStatement() {
+        if (lexer_.CurrentToken().Is<TokenType::Newline>()) {
+            lexer_.NextToken();
+        }
+        const auto& tok = lexer_.CurrentToken();
+        if (tok.Is<TokenType::Eof>()) {
+            return nullptr;
+        }
+        if (tok.Is<TokenType::Class>() || tok.Is<TokenType::If>()) {
+            return ParseStatement();
+        }
+        auto result = ParseSimpleStatement();
+        lexer_.Expect<TokenType::Newline>();
+        return result;
+    }
+
+    // MethodSource -> INDENT (Statement)+ DEDENT EOF
+    unique_ptr<ast::Statement> ParseMethodSource() {
+        auto result = ParseIndentedBlock();
+        lexer_.Expect<TokenType::Eof>();
+        return result;
+    }
+
+private:
+    // Suite -> NEWLINE INDENT (Statement)+ DEDENT
+    unique_ptr<ast::Statement> ParseSuite()  // NOLINT
+    {
+        lexer_.Expect<TokenType::Newline>();
+        lexer_.NextToken();
+        return ParseIndentedBlock();
+    }
+
+    unique_ptr<ast::Statement> ParseIndentedBlock()  // NOLINT
+    {
+        lexer_.Expect<TokenType::Indent>();
+        lexer_.NextToken();
+
+        auto result = make_unique<ast::Compound>();
+        while (!lexer_.CurrentToken().Is<TokenType::Dedent>()) {
+            result->AddStatement(ParseStatement());  // NOLINT
+        }
+
+        lexer_.Expect<TokenType::Dedent>();
+        lexer_.NextToken();
+
+        return result;
+    }
+
+    // Methods -> [def id(Params) : Suite]*
+    vector<runtime::Method> ParseMethods()  // NOLINT
+    {
+        vector<runtime::Method> result;
+
+        while (lexer_.CurrentToken().Is<TokenType::Def>()) {
+            runtime::Method m;
+
+            m.name = GetName(lexer_.ExpectNext<TokenType::Id>().value);
+            lexer_.ExpectNext<TokenType::Char>('(');
+
+            if (lexer_.NextToken().Is<TokenType::Id>()) {
+                m.formal_params.push_back(GetName(lexer_.Expect<TokenType::Id>().value));
+                while (lexer_.NextToken() == ',') {
+                    m.formal_params.push_back(GetName(lexer_.ExpectNext<TokenType::Id>().value));
+                }
+            }
+
+            lexer_.Expect<TokenType::Char>(')');
+            lexer_.ExpectNext<TokenType::Char>(':');
+            lexer_.NextToken();
+
+            if (method_parsing_ == MethodParsing::Lazy && !lexer_.IsBackground()) {
+                lexer_.Expect<TokenType::Newline>();
+                m.body = MakeLazyBody(lexer_.SkipIndentedBlock(), m.formal_params);
+            }
+            else {
+                m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            }
+
+            result.push_back(std::move(m));
+        }
+        return result;
+    }
+
+    // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
+    unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
+    {
+        const parse::Symbol class_symbol = lexer_.Expect<TokenType::Id>().value;
+        string class_name = GetName(class_symbol);
+
+        lexer_.NextToken();
+
+        const runtime::Class* base_class = nullptr;
+        if (lexer_.CurrentToken() == '(') {
+            const parse::Symbol base_symbol = lexer_.ExpectNext<TokenType::Id>().value;
+            lexer_.ExpectNext<TokenType::Char>(')');
+            lexer_.NextToken();
+
+            const runtime::ObjectHolder* base = FindClass(base_symbol);
+            if (base == nullptr) {
+                throw ParseError("Base class "s + GetName(base_symbol) + " not found for class "s
+                                 + class_name);
+            }
+            base_class = static_cast<const runtime::Class*>(base->Get());  // NOLINT
+        }
+
+        lexer_.Expect<TokenType::Char>(':');
+        lexer_.ExpectNext<TokenType::Newline>();
+        lexer_.ExpectNext<TokenType::Indent>();
+        lexer_.ExpectNext<TokenType::Def>();
+        vector<runtime::Method> methods = ParseMethods();  // NOLINT
+
+        lexer_.Expect<TokenType::Dedent>();
+        lexer_.NextToken();
+
+        if (FindClass(class_symbol) != nullptr) {
+            throw ParseError("Class "s + class_name + " already exists"s);
+        }
+
+        runtime::ObjectHolder cls;
+        if (predeclared_ != nullptr) {
+            predeclared_->methods = std::move(methods);
+            predeclared_->parent = base_class;
+            cls = predeclared_->cls;
+            predeclared_ = nullptr;
+        }
+        else {
+            cls = runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class));
+        }
+        declared_classes_.emplace(class_symbol, cls);
+        scope_->Add(cls);
+
+        return make_unique<ast::ClassDefinition>(cls);
+    }
+
+    // Ищет класс, объявленный до текущего места программы
+    const runtime::ObjectHolder* FindClass(parse::Symbol symbol) const {
+        if (const auto it = declared_classes_.find(symbol); it != declared_classes_.end()) {
+            return &it->second;
+        }
+        return scope_->Find(lexer_.GetSymbols().GetName(symbol), scope_->GetSize());
+    }
+
+    // Откладывает разбор тела метода с исходным текстом source до первого вызова.
+    // Телу видны только классы, объявленные до него, как и при полном разборе
+    unique_ptr<ast::Statement> MakeLazyBody(string source, const vector<string>& formal_params) {
+        return make_unique<ast::LazyMethodBody>(
+            [source = std::move(source), formal_params, scope = shared_ptr<const ClassScope>(scope_),
+             class_count = scope_->GetSize()]() -> unique_ptr<ast::Statement> {
+                parse::Lexer lexer(source);
+                unique_ptr<ast::Statement> body
+                    = Parser{lexer, MethodParsing::Lazy, scope, class_count}.ParseMethodSource();
+                ast::FoldConstants(body);
+                auto method_body = make_unique<ast::MethodBody>(std::move(body));
+                ast::ResolveSlots(formal_params, *method_body);
+                return method_body;
+            });
+    }
+
+    vector<parse::Symbol> ParseDottedIds() {
+        vector<parse::Symbol> result;
+        result.push_back(lexer_.Expect<TokenType::Id>().value);
+
+        while (lexer_.NextToken() == '.') {
+            result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+        }
+
+        return result;
+    }
+
+    // Имена в синтаксическом дереве хранятся строками: по ним идёт поиск в Closure
+    [[nodiscard]] string GetName(parse::Symbol symbol) const {
+        return string(lexer_.GetSymbols().GetName(symbol));
+    }
+
+    [[nodiscard]] vector<string> GetNames(const vector<parse::Symbol>& symbols) const {
+        vector<string> result;
+        result.reserve(symbols.size());
+        for (const parse::Symbol symbol : symbols) {
+            result.push_back(GetName(symbol));
+        }
+        return result;
+    }
+
+    //  AssgnOrCall -> DottedIds = Expr
+    //               | DottedIds '(' ExprList ')'
+    unique_ptr<ast::Statement> ParseAssignmentOrCall() {
+        lexer_.Expect<TokenType::Id>();
+
+        vector<parse::Symbol> symbols = ParseDottedIds();
+        string last_name = GetName(symbols.back());
+        symbols.pop_back();
+        vector<string> id_list = GetNames(symbols);
+
+        if (lexer_.CurrentToken() == '=') {
+            lexer_.NextToken();
+
+            if (id_list.empty()) {
+                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+            }
+            return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
+                                                     std::move(last_name), ParseTest());
+        }
+        lexer_.Expect<TokenType::Char>('(');
+        lexer_.NextToken();
+
+        if (id_list.empty()) {
+            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+        }
+
+        vector<unique_ptr<ast::Statement>> args;
+        if (lexer_.CurrentToken() != ')') {
+            args = ParseTestList();
+        }
+        lexer_.Expect<TokenType::Char>(')');
+        lexer_.NextToken();
+
+        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
+                                            std::move(last_name), std::move(args));
+    }
+
+    // Unary -> ['-']* Primary
+    // Унарный минус связывает сильнее умножения: -a * b означает (-a) * b
+    unique_ptr<ast::Statement> ParseUnary() {
+        size_t negations = 0;
+        while (lexer_.CurrentToken() == '-') {
+            lexer_.NextToken();
+            ++negations;
+        }
+        auto result = ParsePrimary();
+        for (; negations > 0; --negations) {
+            result = make_unique<ast::Mult>(std::move(result), make_unique<ast::NumericConst>(-1));
+        }
+        return result;
+    }
+
+    // Primary -> '(' Test ')'
+    //          | NUMBER
+    //          | STRING
+    //          | NONE
+    //          | TRUE
+    //          | FALSE
+    //          | DottedIds '(' ExprList ')'
+    //          | DottedIds
+    unique_ptr<ast::Statement> ParsePrimary()  // NOLINT
+    {
+        if (lexer_.CurrentToken() == '(') {
+            lexer_.NextToken();
+            auto result = ParseTest();
+            lexer_.Expect<TokenType::Char>(')');
+            lexer_.NextToken();
+            return result;
+        }
+        if (const auto num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
+            int result = num->value;
+            lexer_.NextToken();
+            return make_unique<ast::NumericConst>(result);
+        }
+        if (const auto str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
+            string result = GetName(str->value);
+            lexer_.NextToken();
+            return make_unique<ast::StringConst>(std::move(result));
+        }
+        if (lexer_.CurrentToken().Is<TokenType::True>()) {
+            lexer_.NextToken();
+            return make_unique<ast::BoolConst>(runtime::Bool(true));
+        }
+        if (lexer_.CurrentToken().Is<TokenType::False>()) {
+            lexer_.NextToken();
+            return make_unique<ast::BoolConst>(runtime::Bool(false));
+        }
+        if (lexer_.CurrentToken().Is<TokenType::None>()) {
+            lexer_.NextToken();
+            return make_unique<ast::None>();
+        }
+
+        return ParseDottedIdsInMultExpr();
+    }
+
+    std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
+        vector<parse::Symbol> symbols = ParseDottedIds();
+
+        if (lexer_.CurrentToken() == '(') {
+            // various calls
+            vector<unique_ptr<ast::Statement>> args;
+            if (lexer_.NextToken() != ')') {
+                args = ParseTestList();
+            }
+            lexer_.Expect<TokenType::Char>(')');
+            lexer_.NextToken();
+
+            const parse::Symbol method_symbol = symbols.back();
+            symbols.pop_back();
+
+            if (!symbols.empty()) {
+                return make_unique<ast::MethodCall>(
+                    make_unique<ast::VariableValue>(GetNames(symbols)), GetName(method_symbol),
+                    std::move(args));
+            }
+            if (const runtime::ObjectHolder* cls = FindClass(method_symbol)) {
+                return make_unique<ast::NewInstance>(
+                    static_cast<const runtime::Class&>(**cls), std::move(args));  // NOLINT
+            }
+            if (method_symbol == str_symbol_) {
+                if (args.size() != 1) {
+                    throw ParseError("Function str takes exactly one argument"s);
+                }
+                return make_unique<ast::Stringify>(std::move(args.front()));
+            }
+            throw ParseError("Unknown call to "s + GetName(method_symbol) + "()"s);
+        }
+        return make_unique<ast::VariableValue>(GetNames(symbols));
+    }
+
+    vector<unique_ptr<ast::Statement>> ParseTestList()  // NOLINT
+    {
+        vector<unique_ptr<ast::Statement>> result;
+        result.push_back(ParseTest());
+
+        while (lexer_.CurrentToken() == ',') {
+            lexer_.NextToken();
+            result.push_back(ParseTest());
+        }
+        return result;
+    }
+
+    // Condition -> if LogicalExpr: Suite [else: Suite]
+    unique_ptr<ast::Statement> ParseCondition()  // NOLINT
+    {
+        lexer_.Expect<TokenType::If>();
+        lexer_.NextToken();
+
+        auto condition = ParseTest();
+
+        lexer_.Expect<TokenType::Char>(':');
+        lexer_.NextToken();
+
+        auto if_body = ParseSuite();
+
+        unique_ptr<ast::Statement> else_body;
+        if (lexer_.CurrentToken().Is<TokenType::Else>()) {
+            lexer_.ExpectNext<TokenType::Char>(':');
+            lexer_.NextToken();
+            else_body = ParseSuite();
+        }
+
+        return make_unique<ast::IfElse>(std::move(condition), std::move(if_body),
+                                        std::move(else_body));
+    }
+
+    // Приоритеты операций в выражениях, от низшего к высшему
+    enum Precedence : int {
+        NO_OPERATOR = 0,
+        OR,
+        AND,
+        NOT,
+        COMPARISON,
+        SUM,
+        PRODUCT,
+    };
+
+    enum class Operation {
+        Or,
+        And,
+        Compare,
+        Add,
+        Sub,
+        Mult,
+        Div,
+    };
+
+    using ComparatorPtr = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                                   runtime::Context&);
+
+    // Бинарная операция, которую обозначает текущая лексема
+    struct BinaryOperator {
+        Precedence precedence = NO_OPERATOR;
+        Operation operation = Operation::Or;
+        ComparatorPtr comparator = nullptr;  // для операций сравнения
+    };
+
+    [[nodiscard]] BinaryOperator GetBinaryOperator() const {
+        const parse::Token& tok = lexer_.CurrentToken();
+        switch (tok.GetKind()) {
+        case parse::TokenKind::Or:
+            return {OR, Operation::Or};
+        case parse::TokenKind::And:
+            return {AND, Operation::And};
+        case parse::TokenKind::Eq:
+            return {COMPARISON, Operation::Compare, &runtime::Equal};
+        case parse::TokenKind::NotEq:
+            return {COMPARISON, Operation::Compare, &runtime::NotEqual};
+        case parse::TokenKind::LessOrEq:
+            return {COMPARISON, Operation::Compare, &runtime::LessOrEqual};
+        case parse::TokenKind::GreaterOrEq:
+            return {COMPARISON, Operation::Compare, &runtime::GreaterOrEqual};
+        case parse::TokenKind::Char:
+            switch (tok.As<TokenType::Char>().value) {
+            case '<':
+                return {COMPARISON, Operation::Compare, &runtime::Less};
+            case '>':
+                return {COMPARISON, Operation::Compare, &runtime::Greater};
+            case '+':
+                return {SUM, Operation::Add};
+            case '-':
+                return {SUM, Operation::Sub};
+            case '*':
+                return {PRODUCT, Operation::Mult};
+            case '/':
+                return {PRODUCT, Operation::Div};
+            default:
+                return {};
+            }
+        default:
+            return {};
+        }
+    }
+
+    // Test -> Operand [BinaryOp Operand]*
+    // Operand -> NOT Operand | Unary
+    // Бинарные операции левоассоциативны, сравнение в выражении допускается только одно.
+    // Выражение разбирается методом восхождения по приоритетам: глубина рекурсии
+    // определяется вложенностью скобок и приоритетов, а не числом уровней грамматики.
+    // Второе сравнение не принимает ни один уровень восхождения, и оно остаётся
+    // в лексере как неожиданная лексема
+    unique_ptr<ast::Statement> ParseTest(Precedence min_precedence = OR)  // NOLINT
+    {
+        unique_ptr<ast::Statement> result;
+        bool has_comparison = false;
+        if (lexer_.CurrentToken().Is<TokenType::Not>() && min_precedence <= NOT) {
+            lexer_.NextToken();
+            result = make_unique<ast::Not>(ParseTest(NOT));  // NOLINT
+            has_comparison = GetBinaryOperator().precedence == COMPARISON;
+        }
+        else {
+            result = ParseUnary();
+        }
+
+        for (BinaryOperator op = GetBinaryOperator(); op.precedence >= min_precedence;
+             op = GetBinaryOperator()) {
+            if (op.precedence == COMPARISON) {
+                if (has_comparison) {
+                    break;
+                }
+                has_comparison = true;
+            }
+            lexer_.NextToken();
+            auto rhs = ParseTest(static_cast<Precedence>(op.precedence + 1));
+            // Правый операнд, допускающий сравнение, не принял следующее сравнение,
+            // потому что уже содержит своё
+            if (op.precedence < COMPARISON && GetBinaryOperator().precedence == COMPARISON) {
+                has_comparison = true;
+            }
+
+            switch (op.operation) {
+            case Operation::Or:
+                result = make_unique<ast::Or>(std::move(result), std::move(rhs));
+                break;
+            case Operation::And:
+                result = make_unique<ast::And>(std::move(result), std::move(rhs));
+                break;
+            case Operation::Compare:
+                result = make_unique<ast::Comparison>(op.comparator, std::move(result), std::move(rhs));
+                break;
+            case Operation::Add:
+                result = make_unique<ast::Add>(std::move(result), std::move(rhs));
+                break;
+            case Operation::Sub:
+                result = make_unique<ast::Sub>(std::move(result), std::move(rhs));
+                break;
+            case Operation::Mult:
+                result = make_unique<ast::Mult>(std::move(result), std::move(rhs));
+                break;
+            case Operation::Div:
+                result = make_unique<ast::Div>(std::move(result), std::move(rhs));
+                break;
+            }
+        }
+        return result;
+    }
+
+    // Statement -> SimpleStatement Newline
+    //           | class ClassDefinition
+    //           | if Condition
+    unique_ptr<ast::Statement> ParseStatement()  // NOLINT
+    {
+        const auto& tok = lexer_.CurrentToken();
+
+        if (tok.Is<TokenType::Class>()) {
+            lexer_.NextToken();
+            return ParseClassDefinition();  // NOLINT
+        }
+        if (tok.Is<TokenType::If>()) {
+            return ParseCondition();
+        }
+        auto result = ParseSimpleStatement();
+        lexer_.Expect<TokenType::Newline>();
+        lexer_.NextToken();
+        return result;
+    }
+
+    // StatementBody -> return Expression
+    //               | print ExpressionList
+    //               | AssignmentOrCall
+    unique_ptr<ast::Statement> ParseSimpleStatement() {
+        const auto& tok = lexer_.CurrentToken();
+
+        if (tok.Is<TokenType::Return>()) {
+            lexer_.NextToken();
+            return make_unique<ast::Return>(ParseTest());
+        }
+        if (tok.Is<TokenType::Print>()) {
+            lexer_.NextToken();
+            vector<unique_ptr<ast::Statement>> args;
+            if (!lexer_.CurrentToken().Is<TokenType::Newline>()) {
+                args = ParseTestList();
+            }
+            return make_unique<ast::Print>(std::move(args));
+        }
+        return ParseAssignmentOrCall();
+    }
+
+    parse::Lexer& lexer_;
+    const parse::Symbol str_symbol_;
+    const MethodParsing method_parsing_;
+    // Классы, объявленные этим разборщиком. Классы внешних областей ищутся в scope_ по имени
+    unordered_map<parse::Symbol, runtime::ObjectHolder> declared_classes_;
+    shared_ptr<ClassScope> scope_;
+    PredeclaredClass* predeclared_;
+};
+
+// Часть текста программы, разбираемая отдельно от остальных
+struct SourceChunk {
+    string_view text;
+    // Имя класса, объявлением которого начинается часть. Пусто, если часть - не класс
+    string_view class_name;
+};
+
+bool IsIdChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Проверяет, что все строковые константы строки line в ней же и закрываются
+bool ClosesStrings(string_view line) {
+    char quote = 0;
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (quote != 0) {
+            if (c == '\\') {
+                ++i;
+            }
+            else if (c == quote) {
+                quote = 0;
+            }
+        }
+        else if (c == '#') {
+            break;
+        }
+        else if (c == '\'' || c == '"') {
+            quote = c;
+        }
+    }
+    return quote == 0;
+}
+
+/*
+ * Делит текст программы на части по строкам без отступа, которые начинаются с class.
+ * Часть с классом продолжается до следующей строки без отступа, остальные инструкции
+ * верхнего уровня собираются в части между классами. Возвращает false, если отдельный
+ * разбор частей может разойтись с разбором всей программы: класс объявлен с отступом
+ * и был бы виден следующим частям, или строковая константа продолжается на следующей строке
+ */
+bool SplitIntoChunks(string_view source, vector<SourceChunk>& chunks) {
+    static constexpr string_view CLASS = "class"sv;
+
+    size_t chunk_begin = 0;
+    string_view class_name;
+    for (size_t pos = 0; pos < source.size();) {
+        const size_t line_begin = pos;
+        const size_t line_end = min(source.find('\n', pos), source.size());
+        pos = line_end + 1;
+
+        const string_view line = source.substr(line_begin, line_end - line_begin);
+        const size_t first = line.find_first_not_of(" \t\r"sv);
+        if (first == string_view::npos || line[first] == '#') {
+            continue;
+        }
+        if (!ClosesStrings(line.substr(first))) {
+            return false;
+        }
+        const bool is_class = line.substr(first, CLASS.size()) == CLASS
+                              && (first + CLASS.size() == line.size() || !IsIdChar(line[first + CLASS.size()]));
+        // Отступ считается только по пробелам, как в лексере
+        if (line[0] == ' ') {
+            if (is_class) {
+                return false;
+            }
+            continue;
+        }
+        if (!is_class && class_name.empty()) {
+            continue;
+        }
+        if (line_begin > chunk_begin) {
+            chunks.push_back({source.substr(chunk_begin, line_begin - chunk_begin), class_name});
+        }
+        chunk_begin = line_begin;
+        class_name = {};
+        if (is_class) {
+            size_t name_begin = line.find_first_not_of(" \t"sv, first + CLASS.size());
+            name_begin = min(name_begin, line.size());
+            size_t name_end = name_begin;
+            while (name_end < line.size() && IsIdChar(line[name_end])) {
+                ++name_end;
+            }
+            class_name = line.substr(name_begin, name_end - name_begin);
+            if (class_name.empty()) {
+                // Объявление с ошибкой разбирается последовательно, чтобы ошибка была той же
+                return false;
+            }
+        }
+    }
+    if (chunk_begin < source.size()) {
+        chunks.push_back({source.substr(chunk_begin), class_name});
+    }
+    return true;
+}
+
+// Результат разбора одной части программы
+struct ChunkResult {
+    unique_ptr<ast::Statement> statements;
+    PredeclaredClass predeclared;
+    // Сколько классов программы объявлено до этой части
+    size_t visible_count = 0;
+    exception_ptr error;
+};
+
+}  // namespace
+
+unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer, MethodParsing method_parsing) {
+    unique_ptr<ast::Statement> program;
+    {
+        runtime::Arena::Scope arena_scope;
+        program = Parser{lexer, method_parsing}.ParseProgram();
+        ast::FoldConstants(program);
+    }
+    ast::ResolveSlots(*program);
+    return program;
+}
+
+void ParseProgram(parse::Lexer& lexer, const StatementHandler& handler, MethodParsing method_parsing) {
+    Parser parser{lexer, method_parsing};
+    while (true) {
+        unique_ptr<ast::Statement> statement;
+        {
+            // У каждой инструкции своя арена, чтобы память исполненных инструкций освобождалась
+            runtime::Arena::Scope arena_scope;
+            statement = parser.ParseNextStatement();
+            if (!statement) {
+                break;
+            }
+            ast::FoldConstants(statement);
+        }
+        ast::ResolveSlots(*statement);
+        handler(std::move(statement));
+    }
+}
+
+unique_ptr<runtime::Executable> ParseProgramInParallel(string_view source, size_t thread_count,
+                                                       MethodParsing method_parsing) {
+    vector<SourceChunk> chunks;
+    if (thread_count <= 1 || !SplitIntoChunks(source, chunks) || chunks.size() <= 1) {
+        parse::Lexer lexer(source);
+        return ParseProgram(lexer, method_parsing);
+    }
+
+    // Объекты классов создаются заранее, чтобы части могли ссылаться на классы других частей
+    auto program_scope = make_shared<ClassScope>();
+    vector<ChunkResult> results(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        results[i].visible_count = program_scope->GetSize();
+        if (!chunks[i].class_name.empty()) {
+            results[i].predeclared.cls
+                = runtime::ObjectHolder::Own(runtime::Class(string(chunks[i].class_name), {}, nullptr));
+            program_scope->Add(results[i].predeclared.cls);
+        }
+    }
+
+    atomic<size_t> next_chunk{0};
+    auto parse_chunks = [&] {
+        runtime::Arena::Scope arena_scope;
+        for (size_t i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+            ChunkResult& result = results[i];
+            try {
+                parse::Lexer lexer(chunks[i].text);
+                PredeclaredClass* predeclared = result.predeclared.cls ? &result.predeclared : nullptr;
+                result.statements
+                    = Parser{lexer, method_parsing, program_scope, result.visible_count, predeclared}
+                          .ParseProgram();
+                ast::FoldConstants(result.statements);
+            }
+            catch (...) {
+                result.error = current_exception();
+            }
+        }
+    };
+    vector<thread> workers;
+    for (size_t i = 1; i < min(thread_count, chunks.size()); ++i) {
+        workers.emplace_back(parse_chunks);
+    }
+    parse_chunks();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Связывание в порядке объявления. Последовательный разбор остановился бы на первой
+    // по порядку ошибке, поэтому выбрасывается именно она
+    auto program = make_unique<ast::Compound>();
+    for (auto& result : results) {
+        if (result.error) {
+            rethrow_exception(result.error);
+        }
+        if (auto& predeclared = result.predeclared; predeclared.cls) {
+            predeclared.cls.TryAs<runtime::Class>()->Define(std::move(predeclared.methods), predeclared.parent);
+        }
+        for (auto& stmt : static_cast<ast::Compound&>(*result.statements).Statements()) {
+            program->AddStatement(std::move(stmt));
+        }
+    }
+    ast::ResolveSlots(*program);
+    return program;
+}
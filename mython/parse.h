@@ -1,18 +1,51 @@
-#pragma once
-
-#include <memory>
-#include <stdexcept>
-
-namespace parse {
-class Lexer;
-}
-
-namespace runtime {
-class Executable;
-}
-
-struct ParseError : std::runtime_error {
-    using std::runtime_error::runtime_error;
-};
-
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <stdexcept>
+
+namespace parse {
+class Lexer;
+}
+
+namespace runtime {
+class Executable;
+}
+
+struct ParseError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Способ разбора тел методов. При ленивом разборе тело метода при разборе программы
+// только пропускается по отступам, а дерево тела строится при первом вызове метода
+// (см. ast::LazyMethodBody). Ошибки в теле в этом случае выбрасываются при каждом вызове
+// метода, пока тело не будет разобрано успешно. Лексер, работающий в отдельном потоке,
+// не может пропускать текст, поэтому с ним тела методов всегда разбираются сразу
+enum class MethodParsing {
+    Eager,
+    Lazy,
+};
+
+// Разбирает программу, сворачивает константные выражения (см. ast::FoldConstants)
+// и назначает слоты кадров переменным методов (см. ast::ResolveSlots).
+// Узлы дерева размещаются в арене программы (см. runtime::Arena), которая освобождается
+// целиком после уничтожения последнего узла
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer,
+                                                 MethodParsing method_parsing = MethodParsing::Eager);
+
+using StatementHandler = std::function<void(std::unique_ptr<runtime::Executable>)>;
+
+// Разбирает программу по одной инструкции верхнего уровня и передаёт каждую в handler
+// сразу после разбора, не дожидаясь конца входа. Инструкции обрабатываются так же,
+// как в ParseProgram. Ошибка разбора выбрасывается после обработки всех предшествующих инструкций
+void ParseProgram(parse::Lexer& lexer, const StatementHandler& handler,
+                  MethodParsing method_parsing = MethodParsing::Eager);
+
+// Разбирает программу source так же, как ParseProgram, но классы, объявленные без отступа,
+// разбирает параллельно в thread_count потоках. Объекты классов создаются до разбора,
+// а их методы и родители связываются после него в порядке объявления. Если программа
+// содержит ошибки, выбрасывается та же ошибка, что и при последовательном разборе.
+// Программы, в которых классы объявляются с отступом, разбираются последовательно
+std::unique_ptr<runtime::Executable> ParseProgramInParallel(
+    std::string_view source, size_t thread_count, MethodParsing method_parsing = MethodParsing::Eager);
@@ -1,259 +1,707 @@
-#include "lexer.h"
-#include "parse.h"
-#include "statement.h"
-
-#include "test_runner.h"
-
-using namespace std;
-
-namespace parse {
-
-unique_ptr<ast::Statement> ParseProgramFromString(const string& program) {
-    istringstream is(program);
-    parse::Lexer lexer(is);
-    return ParseProgram(lexer);
-}
-
-void TestSimpleProgram() {
-    const string program = R"(
-x = 4
-y = 5
-z = "hello, "
-n = "world"
-print x + y, z + n
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "9 hello, world\n"s);
-}
-
-void TestProgramWithClasses() {
-    const string program = R"(
-program_name = "Classes test"
-
-class Empty:
-  def __init__():
-    x = 0
-
-class Point:
-  def __init__(x, y):
-    self.x = x
-    self.y = y
-
-  def SetX(value):
-    self.x = value
-  def SetY(value):
-    self.y = value
-
-  def __str__():
-    return '(' + str(self.x) + '; ' + str(self.y) + ')'
-
-origin = Empty()
-origin = Point(0, 0)
-
-far_far_away = Point(10000, 50000)
-
-print program_name, origin, far_far_away, origin.SetX(1)
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "Classes test (0; 0) (10000; 50000) None\n"s);
-}
-
-void TestProgramWithIf() {
-    const string program = R"(
-x = 4
-y = 5
-if x > y:
-  print "x > y"
-else:
-  print "x <= y"
-if x > 0:
-  if y < 0:
-    print "y < 0"
-  else:
-    print "y >= 0"
-else:
-  print 'x <= 0'
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "x <= y\ny >= 0\n"s);
-}
-
-void TestReturnFromIf() {
-    const string program = R"(
-class Abs:
-  def calc(n):
-    if n > 0:
-      return n
-    else:
-      return -n
-
-x = Abs()
-print x.calc(2)
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "2\n"s);
-}
-
-void TestRecursion() {
-    const string program = R"(
-class ArithmeticProgression:
-  def calc(n):
-    self.result = 0
-    self.calc_impl(n)
-
-  def calc_impl(n):
-    value = n
-    if value > 0:
-      self.result = self.result + value
-      self.calc_impl(value - 1)
-
-x = ArithmeticProgression()
-x.calc(10)
-print x.result
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "55\n"s);
-}
-
-void TestRecursion2() {
-    const string program = R"(
-class GCD:
-  def __init__():
-    self.call_count = 0
-
-  def calc(a, b):
-    self.call_count = self.call_count + 1
-    if a < b:
-      return self.calc(b, a)
-    if b == 0:
-      return a
-    return self.calc(a - b, b)
-
-x = GCD()
-print x.calc(510510, 18629977)
-print x.calc(22, 17)
-print x.call_count
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "17\n1\n115\n"s);
-}
-
-void TestComplexLogicalExpression() {
-    const string program = R"(
-a = 1
-b = 2
-c = 3
-ok = a + b > c and a + c > b and b + c > a
-print ok
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "False\n"s);
-}
-
-void TestClassicalPolymorphism() {
-    const string program = R"(
-class Shape:
-  def __str__():
-    return "Shape"
-
-class Rect(Shape):
-  def __init__(w, h):
-    self.w = w
-    self.h = h
-
-  def __str__():
-    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
-
-class Circle(Shape):
-  def __init__(r):
-    self.r = r
-
-  def __str__():
-    return 'Circle(' + str(self.r) + ')'
-
-class Triangle(Shape):
-  def __init__(a, b, c):
-    self.ok = a + b > c and a + c > b and b + c > a
-    if (self.ok):
-      self.a = a
-      self.b = b
-      self.c = c
-
-  def __str__():
-    if self.ok:
-      return 'Triangle(' + str(self.a) + ', ' + str(self.b) + ', ' + str(self.c) + ')'
-    else:
-      return 'Wrong triangle'
-
-r = Rect(10, 20)
-c = Circle(52)
-t1 = Triangle(3, 4, 5)
-t2 = Triangle(125, 1, 2)
-
-print r, c, t1, t2
-)"s;
-
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(),
-                 "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
-}
-
-}  // namespace parse
-
-void TestParseProgram(TestRunner& tr) {
-    RUN_TEST(tr, parse::TestSimpleProgram);
-    RUN_TEST(tr, parse::TestProgramWithClasses);
-    RUN_TEST(tr, parse::TestProgramWithIf);
-    RUN_TEST(tr, parse::TestReturnFromIf);
-    RUN_TEST(tr, parse::TestRecursion);
-    RUN_TEST(tr, parse::TestRecursion2);
-    RUN_TEST(tr, parse::TestComplexLogicalExpression);
-    RUN_TEST(tr, parse::TestClassicalPolymorphism);
-}
+#include "arena.h"
+#include "lexer.h"
+#include "parse.h"
+#include "serialize.h"
+#include "statement.h"
+
+#include "test_runner.h"
+
+#include <filesystem>
+#include <fstream>
+#include <typeinfo>
+
+using namespace std;
+
+namespace parse {
+
+unique_ptr<ast::Statement> ParseProgramFromString(const string& program,
+                                                  MethodParsing method_parsing = MethodParsing::Eager) {
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    return ParseProgram(lexer, method_parsing);
+}
+
+void TestSimpleProgram() {
+    const string program = R"(
+x = 4
+y = 5
+z = "hello, "
+n = "world"
+print x + y, z + n
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "9 hello, world\n"s);
+}
+
+void TestProgramWithClasses() {
+    const string program = R"(
+program_name = "Classes test"
+
+class Empty:
+  def __init__():
+    x = 0
+
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def SetX(value):
+    self.x = value
+  def SetY(value):
+    self.y = value
+
+  def __str__():
+    return '(' + str(self.x) + '; ' + str(self.y) + ')'
+
+origin = Empty()
+origin = Point(0, 0)
+
+far_far_away = Point(10000, 50000)
+
+print program_name, origin, far_far_away, origin.SetX(1)
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "Classes test (0; 0) (10000; 50000) None\n"s);
+}
+
+void TestProgramWithIf() {
+    const string program = R"(
+x = 4
+y = 5
+if x > y:
+  print "x > y"
+else:
+  print "x <= y"
+if x > 0:
+  if y < 0:
+    print "y < 0"
+  else:
+    print "y >= 0"
+else:
+  print 'x <= 0'
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "x <= y\ny >= 0\n"s);
+}
+
+void TestReturnFromIf() {
+    const string program = R"(
+class Abs:
+  def calc(n):
+    if n > 0:
+      return n
+    else:
+      return -n
+
+x = Abs()
+print x.calc(2)
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "2\n"s);
+}
+
+void TestRecursion() {
+    const string program = R"(
+class ArithmeticProgression:
+  def calc(n):
+    self.result = 0
+    self.calc_impl(n)
+
+  def calc_impl(n):
+    value = n
+    if value > 0:
+      self.result = self.result + value
+      self.calc_impl(value - 1)
+
+x = ArithmeticProgression()
+x.calc(10)
+print x.result
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "55\n"s);
+}
+
+void TestRecursion2() {
+    const string program = R"(
+class GCD:
+  def __init__():
+    self.call_count = 0
+
+  def calc(a, b):
+    self.call_count = self.call_count + 1
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+x = GCD()
+print x.calc(510510, 18629977)
+print x.calc(22, 17)
+print x.call_count
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "17\n1\n115\n"s);
+}
+
+void TestComplexLogicalExpression() {
+    const string program = R"(
+a = 1
+b = 2
+c = 3
+ok = a + b > c and a + c > b and b + c > a
+print ok
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "False\n"s);
+}
+
+void TestBorrowedOperandsSurviveMethodCalls() {
+    // Методы, вызываемые при вычислении выражения, изменяют поля, из которых
+    // заимствованы операнды, и удаляют последнюю ссылку на печатаемый объект
+    const string program = R"(
+class Item:
+  def __init__(v):
+    self.v = v
+
+  def __str__():
+    self.owner.item = None
+    return str(self.v)
+
+class Holder:
+  def __init__():
+    self.count = 5
+
+  def grow():
+    self.a = 1
+    self.b = 2
+    self.c = 3
+    self.d = 4
+    self.e = 5
+    self.count = 7
+    return 6
+
+  def check():
+    return self.count < self.grow()
+
+h = Holder()
+print h.check(), h.count
+h.item = Item(3)
+h.item.owner = h
+print h.item
+print h.item
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "True 7\n3\nNone\n"s);
+}
+
+void TestClassicalPolymorphism() {
+    const string program = R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def __str__():
+    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
+
+class Circle(Shape):
+  def __init__(r):
+    self.r = r
+
+  def __str__():
+    return 'Circle(' + str(self.r) + ')'
+
+class Triangle(Shape):
+  def __init__(a, b, c):
+    self.ok = a + b > c and a + c > b and b + c > a
+    if (self.ok):
+      self.a = a
+      self.b = b
+      self.c = c
+
+  def __str__():
+    if self.ok:
+      return 'Triangle(' + str(self.a) + ', ' + str(self.b) + ', ' + str(self.c) + ')'
+    else:
+      return 'Wrong triangle'
+
+r = Rect(10, 20)
+c = Circle(52)
+t1 = Triangle(3, 4, 5)
+t2 = Triangle(125, 1, 2)
+
+print r, c, t1, t2
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(),
+                 "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
+}
+
+void TestMethodLocalsInSlots() {
+    const string program = R"(
+class Swapper:
+  def run(a, b):
+    t = a
+    a = b
+    b = t
+    x = a - b
+    return x
+
+  def unbound(flag):
+    if flag:
+      value = 1
+    return value
+
+x = 'global'
+s = Swapper()
+print s.run(1, 2), x
+print s.unbound(True)
+print s.unbound(False)
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    ASSERT_THROWS(tree->Execute(closure, context), runtime_error);
+
+    ASSERT_EQUAL(context.output.str(), "1 global\n1\n"s);
+    ASSERT_EQUAL(closure.at("x"s).TryAs<runtime::String>()->GetValue(), "global"s);
+
+    // self, a, b, t, x
+    const auto* cls = closure.at("Swapper"s).TryAs<runtime::Class>();
+    const auto& body = dynamic_cast<const ast::MethodBody&>(*cls->GetMethod("run"s)->body);
+    ASSERT_EQUAL(body.GetFrameSize(), 5U);
+    const auto& statements = dynamic_cast<const ast::Compound&>(body.GetBody()).GetStatements();
+    const auto& first = dynamic_cast<const ast::Assignment&>(*statements.front());
+    ASSERT_EQUAL(first.GetSlot().value(), 3U);
+    const auto& rv = dynamic_cast<const ast::VariableValue&>(first.GetRightValue());
+    ASSERT_EQUAL(rv.GetSlot().value(), 1U);
+}
+
+void TestNodesLiveInProgramArena() {
+    runtime::Arena* arena = nullptr;
+    unique_ptr<ast::Statement> first;
+    unique_ptr<ast::Statement> second;
+    {
+        runtime::Arena::Scope scope;
+        arena = runtime::Arena::GetCurrent();
+        first = make_unique<ast::NumericConst>(1);
+        second = make_unique<ast::Print>(make_unique<ast::StringConst>("x"s));
+        ASSERT_EQUAL(arena->GetLiveCount(), 3U);
+        ASSERT_EQUAL(arena->GetBlockCount(), 1U);
+    }
+    ASSERT(runtime::Arena::GetCurrent() == nullptr);
+
+    // Узлы размещены подряд в одном блоке арены
+    const auto begin = reinterpret_cast<uintptr_t>(first.get());
+    const auto end = reinterpret_cast<uintptr_t>(second.get());
+    ASSERT(begin < end && end - begin < runtime::Arena::BLOCK_SIZE);
+
+    first.reset();
+    ASSERT_EQUAL(arena->GetLiveCount(), 2U);
+    // Вместе с последним узлом освобождается и сама арена
+    second.reset();
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString("x = 1\nprint x + 1\n"s)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "2\n"s);
+}
+
+void TestConstantFolding() {
+    const string program = R"(
+x = 2*5+10/2
+s = 'a' + str(1 + -2)
+b = not (1 < 2 and 'x' == 'x')
+if 2 > 1:
+  y = 1
+else:
+  y = 1/0
+if False:
+  z = 1/0
+print x, s, b, y
+print 1/0
+)"s;
+
+    auto tree = ParseProgramFromString(program);
+    const auto& statements = dynamic_cast<const ast::Compound&>(*tree).GetStatements();
+    // Ветви if с константным условием встроены в программу, а ветвь с if False удалена
+    ASSERT_EQUAL(statements.size(), 6U);
+
+    const auto value = [&](size_t index) -> const ast::Statement& {
+        return dynamic_cast<const ast::Assignment&>(*statements.at(index)).GetRightValue();
+    };
+    ASSERT_EQUAL(dynamic_cast<const ast::NumericConst&>(value(0)).GetValue().GetValue(), 15);
+    ASSERT_EQUAL(dynamic_cast<const ast::StringConst&>(value(1)).GetValue().GetValue(), "a-1"s);
+    ASSERT_EQUAL(dynamic_cast<const ast::BoolConst&>(value(2)).GetValue().GetValue(), false);
+    ASSERT_EQUAL(dynamic_cast<const ast::NumericConst&>(value(3)).GetValue().GetValue(), 1);
+
+    // Деление на ноль не сворачивается и по-прежнему приводит к ошибке при выполнении
+    const auto& last = dynamic_cast<const ast::Print&>(*statements.back());
+    ASSERT(dynamic_cast<const ast::Div*>(last.GetArgs().front().get()) != nullptr);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ASSERT_THROWS(tree->Execute(closure, context), runtime_error);
+    ASSERT_EQUAL(context.output.str(), "15 a-1 False 1\n"s);
+}
+
+void TestDeadBranchKeepsClassDefinitions() {
+    const string program = R"(
+if False:
+  class A:
+    def f():
+      return 1
+x = A()
+print x.f()
+)"s;
+
+    for (size_t threads : {1, 2}) {
+        auto tree = ParseProgramInParallel(program, threads);
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        tree->Execute(closure, context);
+        ASSERT_EQUAL(context.output.str(), "1\n"s);
+    }
+}
+
+void TestProgramCache() {
+    const string program = R"(
+class Shape:
+  def __init__(name):
+    self.name = name
+
+  def __str__():
+    return 'Shape ' + self.name
+
+  def area():
+    return 0
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.name = 'rect'
+    self.w = w
+    self.h = h
+
+  def area():
+    if self.w < 0 or not self.h >= 0:
+      return None
+    result = self.w * self.h
+    return result
+
+r = Rect(2, 3)
+s = Shape('dot')
+print r, r.area(), s.area(), str(s) + '!', r.w != r.h
+r.w = -1
+print r.area(), 10 / (r.w + 1)
+)"s;
+    // Print выводит аргументы по мере вычисления, поэтому деление на ноль прерывает строку
+    const string expected = "Shape rect 6 0 Shape dot! True\nNone "s;
+
+    const auto run = [](runtime::Executable& tree) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        try {
+            tree.Execute(closure, context);
+        } catch (const runtime_error&) {
+            context.output << "error"s;
+        }
+        return context.output.str();
+    };
+
+    ostringstream saved;
+    ast::SaveProgram(*ParseProgramFromString(program), saved);
+    istringstream input(saved.str());
+    auto loaded = ast::LoadProgram(input);
+    ASSERT_EQUAL(run(*loaded), expected + "error"s);
+
+    // Обрезанные данные не должны приводить к неопределённому поведению
+    istringstream truncated(saved.str().substr(0, saved.str().size() / 2));
+    ASSERT_THROWS(ast::LoadProgram(truncated), ast::SerializeError);
+
+    // Длины из повреждённых данных не выделяют память сверх размера данных:
+    // строка длиной 0xFFFFFFFF и класс с 0xFFFFFFFF методами
+    const string huge_string = "\x01\xff\xff\xff\xff"s;
+    const string huge_class = "\x16\x00\x00\x00\x00\xff\xff\xff\xff\xff\xff\xff\xff"s;
+    for (const string& corrupted : {huge_string, huge_class}) {
+        istringstream corrupted_input(corrupted);
+        ASSERT_THROWS(ast::LoadProgram(corrupted_input), ast::SerializeError);
+    }
+
+    const auto directory = filesystem::temp_directory_path()
+                           / ("mython_cache_test_"s + to_string(ast::ProgramCache::HashSource(saved.str())));
+    filesystem::remove_all(directory);
+    {
+        ast::ProgramCache cache(directory);
+        ASSERT_EQUAL(run(*cache.Load(program)), expected + "error"s);
+        ASSERT(filesystem::exists(cache.GetPath(program)));
+        ASSERT_EQUAL(run(*cache.Load(program)), expected + "error"s);
+        ASSERT_EQUAL(cache.GetHits(), 1U);
+        ASSERT_EQUAL(cache.GetMisses(), 1U);
+
+        // Изменённый текст программы разбирается заново
+        ASSERT_EQUAL(run(*cache.Load("print 'changed'\n"s)), "changed\n"s);
+        ASSERT_EQUAL(cache.GetMisses(), 2U);
+    }
+    {
+        // Повреждённый файл кэша заменяется заново разобранной программой
+        ast::ProgramCache cache(directory);
+        ofstream(cache.GetPath(program), ios::binary | ios::trunc) << "MYTHONC2garbage"s;
+        ASSERT_EQUAL(run(*cache.Load(program)), expected + "error"s);
+        ASSERT_EQUAL(run(*cache.Load(program)), expected + "error"s);
+        ASSERT_EQUAL(cache.GetHits(), 1U);
+
+        // Так же заменяется файл с верным заголовком и огромным числом методов класса
+        // Заголовок: сигнатура, длина и текст программы
+        string header(8 + 8 + program.size(), '\0');
+        {
+            ifstream valid(cache.GetPath(program), ios::binary);
+            valid.read(header.data(), static_cast<streamsize>(header.size()));
+        }
+        ofstream(cache.GetPath(program), ios::binary | ios::trunc) << header << huge_class;
+        ASSERT_EQUAL(run(*cache.Load(program)), expected + "error"s);
+        ASSERT_EQUAL(cache.GetHits(), 1U);
+        ASSERT_EQUAL(cache.GetMisses(), 2U);
+
+        // Файл другой программы под тем же именем (например, при совпадении хешей) не используется
+        const string other = "print 'other'\n"s;
+        ASSERT_EQUAL(run(*cache.Load(other)), "other\n"s);
+        filesystem::copy_file(cache.GetPath(other), cache.GetPath(program),
+                              filesystem::copy_options::overwrite_existing);
+        ASSERT_EQUAL(run(*cache.Load(program)), expected + "error"s);
+        ASSERT_EQUAL(cache.GetHits(), 1U);
+        ASSERT_EQUAL(cache.GetMisses(), 4U);
+    }
+    filesystem::remove_all(directory);
+}
+
+void TestExpressionPrecedence() {
+    {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        ParseProgramFromString(R"(
+a = 1
+b = 2
+c = 4
+print a + b * c - -c / b, - a - - b, not a < b or c > b and not False, (a + b) * c
+print a == 1 and b != 1, a <= b, c >= b * 2, -(a + b) * c, a - b - c, c / b / b
+x = a - b * -c
+)"s)->Execute(closure, context);
+        ASSERT_EQUAL(context.output.str(), "11 1 True 12\nTrue True True -12 -5 1\n"s);
+    }
+    {
+        auto tree = ParseProgramFromString("x = a - b * -c\n"s);
+        const auto& assignment = dynamic_cast<const ast::Assignment&>(
+            *dynamic_cast<const ast::Compound&>(*tree).GetStatements().front());
+        const auto& sub = dynamic_cast<const ast::Sub&>(assignment.GetRightValue());
+        const auto& mult = dynamic_cast<const ast::Mult&>(sub.GetRhs());
+        const auto& negation = dynamic_cast<const ast::Mult&>(mult.GetRhs());
+        ASSERT_EQUAL(dynamic_cast<const ast::NumericConst&>(negation.GetRhs()).GetValue().GetValue(), -1);
+    }
+    {
+        // Глубина рекурсии определяется только вложенностью скобок
+        const size_t depth = 200;
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        ParseProgramFromString("print "s + string(depth, '(') + "1"s + string(depth, ')') + "\n"s)
+            ->Execute(closure, context);
+        ASSERT_EQUAL(context.output.str(), "1\n"s);
+    }
+    // Сравнения не объединяются в цепочки
+    ASSERT_THROWS(ParseProgramFromString("print 1 < 2 < 3\n"s), parse::LexerError);
+    ASSERT_THROWS(ParseProgramFromString("print 1 or 2 < 3 < 1\n"s), parse::LexerError);
+    ASSERT_THROWS(ParseProgramFromString("print 1 and 2 < 3 == 1\n"s), parse::LexerError);
+    ASSERT_THROWS(ParseProgramFromString("print not 1 < 2 < 3\n"s), parse::LexerError);
+    ASSERT_THROWS(ParseProgramFromString("x = 1 < 2 or 1 and 2 < 3 > 1\n"s), parse::LexerError);
+}
+
+void TestLazyMethodBodies() {
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.n = 0
+class Lib:
+  def twice(x):
+    c = Counter()
+
+    # комментарий внутри тела
+    if x > 0:
+      c.n = x * 2
+    return c.n
+# комментарий с меньшим отступом
+  def broken():
+    return 1 +
+  def later():
+    return Later()
+
+class Later:
+  def get():
+    return 1
+
+lib = Lib()
+)"s;
+    ASSERT_THROWS(ParseProgramFromString(program), parse::LexerError);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program, MethodParsing::Lazy);
+    tree->Execute(closure, context);
+
+    auto& lib = *closure.at("lib"s).TryAs<runtime::ClassInstance>();
+    auto is_loaded = [&lib](const string& name) {
+        return dynamic_cast<const ast::LazyMethodBody&>(*lib.GetClass().GetMethod(name)->body).IsLoaded();
+    };
+    ASSERT(!is_loaded("twice"s) && !is_loaded("broken"s));
+
+    ASSERT_EQUAL(lib.Call("twice"s, {runtime::ObjectHolder::Own(runtime::Number{21})}, context)
+                     .TryAs<runtime::Number>()->GetValue(), 42);
+    ASSERT_EQUAL(lib.Call("twice"s, {runtime::ObjectHolder::Own(runtime::Number{-1})}, context)
+                     .TryAs<runtime::Number>()->GetValue(), 0);
+    ASSERT(is_loaded("twice"s) && !is_loaded("broken"s));
+
+    // Ошибка разбора выбрасывается при каждом вызове, а не только при первом
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_THROWS(lib.Call("broken"s, {}, context), parse::LexerError);
+    }
+    // Как и при полном разборе, тело метода видит только классы, объявленные до него
+    ASSERT_THROWS(lib.Call("later"s, {}, context), ParseError);
+
+    ASSERT_THROWS(ParseProgramFromString("class A:\n  def f():\n  def g():\n    return 1\n"s,
+                                         MethodParsing::Lazy),
+                  parse::LexerError);
+}
+
+void TestParallelParsing() {
+    auto run = [](const string& program, size_t thread_count) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        ParseProgramInParallel(program, thread_count)->Execute(closure, context);
+        return context.output.str();
+    };
+    auto error = [](const string& program, size_t thread_count) {
+        try {
+            ParseProgramInParallel(program, thread_count);
+        }
+        catch (const exception& e) {
+            return string(typeid(e).name()) + ": "s + e.what();
+        }
+        return "no error"s;
+    };
+
+    string program = "total = 0\n"s;
+    for (int i = 0; i < 200; ++i) {
+        const string name = "C"s + to_string(i);
+        if (i == 0) {
+            program += "class C0:\n  def value():\n    return 0\n"s;
+        }
+        else {
+            // Каждый класс наследует предыдущий и создаёт его экземпляр
+            const string base = "C"s + to_string(i - 1);
+            program += "class "s + name + "("s + base + "):\n  def value():\n"s + "    prev = "s + base
+                       + "()\n    return prev.value() + "s + to_string(i) + "\n"s;
+        }
+        program += "c = "s + name + "()\ntotal = total + c.value()\n"s;
+    }
+    program += "print total\n"s;
+
+    ASSERT_EQUAL(run(program, 4), run(program, 1));
+    ASSERT_EQUAL(run(program, 4), "1333300\n"s);
+
+    // Ошибки совпадают с ошибками последовательного разбора, даже если в нескольких
+    // частях программы есть ошибки
+    const vector<string> broken = {
+        program + "class C5:\n  def f():\n    return 1\n"s,
+        "class A(B):\n  def f():\n    return 1\nclass B:\n  def f():\n    return 1\n"s,
+        "class A:\n  def f():\n    return B()\nclass B:\n  def f(:\n    return 1\n"s,
+        "class A:\n  def f():\n    return 1 +\nclass B:\n  def f(:\n    return 1\n"s,
+        "x = 1\nclass A:\n  def f():\n    return 1\ny = A(\nclass B:\n  def f():\n    return 1 +\n"s,
+        "class A:\n  def f():\n    return 1\n  class B:\n    def f():\n      return 1\nx = B()\n"s,
+    };
+    for (const auto& text : broken) {
+        ASSERT_EQUAL(error(text, 4), error(text, 1));
+        ASSERT(error(text, 4) != "no error"s);
+    }
+}
+
+}  // namespace parse
+
+void TestParseProgram(TestRunner& tr) {
+    RUN_TEST(tr, parse::TestSimpleProgram);
+    RUN_TEST(tr, parse::TestProgramWithClasses);
+    RUN_TEST(tr, parse::TestProgramWithIf);
+    RUN_TEST(tr, parse::TestReturnFromIf);
+    RUN_TEST(tr, parse::TestRecursion);
+    RUN_TEST(tr, parse::TestRecursion2);
+    RUN_TEST(tr, parse::TestComplexLogicalExpression);
+    RUN_TEST(tr, parse::TestBorrowedOperandsSurviveMethodCalls);
+    RUN_TEST(tr, parse::TestClassicalPolymorphism);
+    RUN_TEST(tr, parse::TestMethodLocalsInSlots);
+    RUN_TEST(tr, parse::TestNodesLiveInProgramArena);
+    RUN_TEST(tr, parse::TestConstantFolding);
+    RUN_TEST(tr, parse::TestDeadBranchKeepsClassDefinitions);
+    RUN_TEST(tr, parse::TestProgramCache);
+    RUN_TEST(tr, parse::TestExpressionPrecedence);
+    RUN_TEST(tr, parse::TestLazyMethodBodies);
+    RUN_TEST(tr, parse::TestParallelParsing);
+}
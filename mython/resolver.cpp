@@ -0,0 +1,135 @@
+#include "resolver.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+    namespace {
+
+        void ResolveClass(const runtime::ObjectHolder& cls);
+
+        // Обходит дерево и назначает слоты переменным метода.
+        // Для программы верхнего уровня (method == nullptr) слоты не назначаются,
+        // но объявленные в ней классы разрешаются
+        class SlotResolver {
+        public:
+            SlotResolver() = default;
+
+            explicit SlotResolver(const vector<string>& formal_params)
+                : in_method_(true) {
+                Declare("self"s);
+                for (const auto& param : formal_params) {
+                    // При совпадении имён параметров в Closure побеждает последний из них
+                    slots_[param] = names_.size();
+                    names_.push_back(param);
+                }
+            }
+
+            void Resolve(Statement& stmt) {
+                if (auto* value = dynamic_cast<VariableValue*>(&stmt)) {
+                    if (in_method_) {
+                        value->SetSlot(Declare(value->GetDottedIds().front()));
+                    }
+                }
+                else if (auto* assignment = dynamic_cast<Assignment*>(&stmt)) {
+                    Resolve(*assignment->RightValue());
+                    if (in_method_) {
+                        assignment->SetSlot(Declare(assignment->GetVarName()));
+                    }
+                }
+                else if (auto* field_assignment = dynamic_cast<FieldAssignment*>(&stmt)) {
+                    Resolve(field_assignment->Object());
+                    Resolve(*field_assignment->RightValue());
+                }
+                else if (auto* print = dynamic_cast<Print*>(&stmt)) {
+                    ResolveAll(print->Args());
+                }
+                else if (auto* call = dynamic_cast<MethodCall*>(&stmt)) {
+                    Resolve(*call->Object());
+                    ResolveAll(call->Args());
+                }
+                else if (auto* instance = dynamic_cast<NewInstance*>(&stmt)) {
+                    ResolveAll(instance->Args());
+                }
+                else if (auto* unary = dynamic_cast<UnaryOperation*>(&stmt)) {
+                    Resolve(*unary->Argument());
+                }
+                else if (auto* binary = dynamic_cast<BinaryOperation*>(&stmt)) {
+                    Resolve(*binary->Lhs());
+                    Resolve(*binary->Rhs());
+                }
+                else if (auto* compound = dynamic_cast<Compound*>(&stmt)) {
+                    ResolveAll(compound->Statements());
+                }
+                else if (auto* ret = dynamic_cast<Return*>(&stmt)) {
+                    Resolve(*ret->ReturnValue());
+                }
+                else if (auto* if_else = dynamic_cast<IfElse*>(&stmt)) {
+                    Resolve(*if_else->Condition());
+                    Resolve(*if_else->IfBody());
+                    if (if_else->ElseBody()) {
+                        Resolve(*if_else->ElseBody());
+                    }
+                }
+                else if (auto* definition = dynamic_cast<ClassDefinition*>(&stmt)) {
+                    const auto& cls = definition->GetClass();
+                    if (in_method_) {
+                        definition->SetSlot(Declare(cls.TryAs<runtime::Class>()->GetName()));
+                    }
+                    ResolveClass(cls);
+                }
+            }
+
+            [[nodiscard]] const vector<string>& GetNames() const {
+                return names_;
+            }
+
+        private:
+            size_t Declare(const string& name) {
+                const auto [it, inserted] = slots_.emplace(name, names_.size());
+                if (inserted) {
+                    names_.push_back(name);
+                }
+                return it->second;
+            }
+
+            void ResolveAll(vector<unique_ptr<Statement>>& statements) {
+                for (auto& stmt : statements) {
+                    Resolve(*stmt);
+                }
+            }
+
+            bool in_method_ = false;
+            unordered_map<string, size_t> slots_;
+            vector<string> names_;
+        };
+
+        void ResolveClass(const runtime::ObjectHolder& cls) {
+            for (auto& method : cls.TryAs<runtime::Class>()->Methods()) {
+                auto* body = dynamic_cast<MethodBody*>(method.body.get());
+                if (!body) {
+                    continue;
+                }
+                ResolveSlots(method.formal_params, *body);
+            }
+        }
+
+    }  // namespace
+
+    void ResolveSlots(const vector<string>& formal_params, MethodBody& body) {
+        SlotResolver resolver(formal_params);
+        resolver.Resolve(*body.Body());
+        const auto& names = resolver.GetNames();
+        body.SetFrameLayout(
+            vector<string>(names.begin(), names.begin() + 1 + formal_params.size()), names.size());
+    }
+
+    void ResolveSlots(Statement& program) {
+        SlotResolver{}.Resolve(program);
+    }
+
+}  // namespace ast
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "statement.h"
+
+namespace ast {
+
+    /*
+     * Разрешает имена переменных в методах классов, объявленных в программе program.
+     * Каждому методу назначается кадр: слот 0 занимает self, следующие слоты - параметры
+     * метода в порядке их объявления, за ними - локальные переменные в порядке первого
+     * упоминания. Обращения к переменным внутри метода после этого выполняются по номеру
+     * слота. Переменные программы верхнего уровня по-прежнему ищутся по имени в Closure
+     */
+    void ResolveSlots(Statement& program);
+
+    // Назначает кадр телу одного метода с параметрами formal_params
+    void ResolveSlots(const std::vector<std::string>& formal_params, MethodBody& body);
+
+}  // namespace ast
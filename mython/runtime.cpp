@@ -1,204 +1,643 @@
-#include "runtime.h"
-
-#include <cassert>
-#include <optional>
-#include <sstream>
-#include <functional>
-
-using namespace std;
-
-namespace runtime {
-    namespace {
-        const string STR_METHOD = "__str__"s;
-        const string LT_METHOD = "__lt__"s;
-        const string EQ_METHOD = "__eq__"s;
-    }  // namespace
-
-    ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-        : data_(std::move(data)) {
-    }
-
-    void ObjectHolder::AssertIsValid() const {
-        assert(data_ != nullptr);
-    }
-
-    ObjectHolder ObjectHolder::Share(Object& object) {
-        // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-        return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
-    }
-
-    ObjectHolder ObjectHolder::None() {
-        return {};
-    }
-
-    Object& ObjectHolder::operator*() const {
-        AssertIsValid();
-        return *Get();
-    }
-
-    Object* ObjectHolder::operator->() const {
-        AssertIsValid();
-        return Get();
-    }
-
-    Object* ObjectHolder::Get() const {
-        return data_.get();
-    }
-
-    ObjectHolder::operator bool() const {
-        return Get() != nullptr;
-    }
-
-    bool IsTrue(const ObjectHolder& object) {
-        if (!object) {
-            return false;
-        }
-        else {
-            if (object.TryAs<Bool>()) {
-                return object.TryAs<Bool>()->GetValue();
-            }
-            else if (object.TryAs<Number>()) {
-                return object.TryAs<Number>()->GetValue() != 0;
-            }
-            else if (object.TryAs<String>()) {
-                return !object.TryAs<String>()->GetValue().empty();
-            }
-            else if (object.TryAs<Class>()) {
-                return false;
-            }
-            else if (object.TryAs<ClassInstance>()) {
-                return false;
-            }
-
-        }
-        return true;
-    }
-
-    ClassInstance::ClassInstance(const Class& cls) : class_(cls) {}
-
-    void ClassInstance::Print(std::ostream& os, Context& context) {
-        if (HasMethod(STR_METHOD, 0)) {
-            Call(STR_METHOD, {}, context)->Print(os, context);
-        }
-        else {
-            os << this;
-        }
-    }
-
-    bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
-        auto* tmp_method = class_.GetMethod(method);
-        return tmp_method && tmp_method->formal_params.size() == argument_count;
-    }
-
-    Closure& ClassInstance::Fields() {
-        return closure_;
-    }
-
-    const Closure& ClassInstance::Fields() const {
-        return closure_;
-    }
-
-    ObjectHolder ClassInstance::Call(const std::string& method,
-        const std::vector<ObjectHolder>& actual_args,
-        Context& context) {
-        if (!HasMethod(method, actual_args.size())) {
-            throw std::runtime_error("Method not found."s);
-        }
-        auto* tmp_method = class_.GetMethod(method);
-        Closure tmp_closure;
-        tmp_closure["self"s] = ObjectHolder::Share(*this);
-        for (size_t i = 0; i < tmp_method->formal_params.size(); ++i) {
-            tmp_closure[tmp_method->formal_params.at(i)] = actual_args.at(i);
-        }
-        return tmp_method->body->Execute(tmp_closure, context);
-    }
-
-    Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
-        : name_(std::move(name)), methods_(std::move(methods)), parent_(parent) {}
-
-    const Method* Class::GetMethod(const std::string& name) const {
-        for (const auto& met : methods_) {
-            if (met.name == name) {
-                return &met;
-            }
-            else {
-                continue;
-            }
-        }if (parent_) {
-            return parent_->GetMethod(name);
-        }
-        return nullptr;
-    }
-
-    [[nodiscard]] const std::string& Class::GetName() const {
-        return name_;
-    }
-
-    void Class::Print(ostream& os, [[maybe_unused]] Context& context) {
-        os << "Class "sv << name_;
-    }
-
-    void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
-        os << (GetValue() ? "True"sv : "False"sv);
-    }
-
-    template<typename C>
-    bool Comp(const ObjectHolder& lhs, const ObjectHolder& rhs, C pred = C{}) {
-            if (lhs.TryAs<Bool>() && rhs.TryAs<Bool>()) {
-                return pred(lhs.TryAs<Bool>()->GetValue(), rhs.TryAs<Bool>()->GetValue());
-            }
-            if (lhs.TryAs<Number>() && rhs.TryAs<Number>()) {
-                return pred(lhs.TryAs<Number>()->GetValue(), rhs.TryAs<Number>()->GetValue());
-            }
-            if (lhs.TryAs<String>() && rhs.TryAs<String>()) {
-                return pred(lhs.TryAs<String>()->GetValue(), rhs.TryAs<String>()->GetValue());   
-        }
-        throw std::runtime_error("Cannot compare objects"s);
-    }
-
-
-    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        try {
-            return Comp(lhs, rhs, std::equal_to<>{});
-        }
-        catch (std::runtime_error&) {
-            if (lhs.TryAs<ClassInstance>() && lhs.TryAs<ClassInstance>()->HasMethod(EQ_METHOD, 1)) {
-                return lhs.TryAs<ClassInstance>()->Call(EQ_METHOD, { rhs }, context).TryAs<Bool>()->GetValue();
-            }
-            if (!lhs.operator bool() && !rhs.operator bool()) {
-                return true;
-            }
-            throw std::runtime_error("Cannot compare objects for equal"s);
-        }
-    }
-
-    bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        try {
-            return Comp(lhs, rhs, std::less<>{});
-        }
-        catch (std::runtime_error&) {
-
-            if (lhs.TryAs<ClassInstance>() && lhs.TryAs<ClassInstance>()->HasMethod(LT_METHOD, 1)) {
-                return lhs.TryAs<ClassInstance>()->Call(LT_METHOD, { rhs }, context).TryAs<Bool>()->GetValue();
-            }
-            throw std::runtime_error("Cannot compare objects for less"s);
-        }
-    }
-
-    bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !Equal(lhs, rhs, context);
-    }
-
-    bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !(Less(lhs, rhs, context) || Equal(lhs, rhs, context));
-    }
-
-    bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !Greater(lhs, rhs, context);
-    }
-
-    bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-        return !Less(lhs, rhs, context);
-    }
-
-}  // namespace runtime
+#include "runtime.h"
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <sstream>
+#include <functional>
+
+using namespace std;
+
+namespace runtime {
+    namespace {
+        // Имена специальных методов в порядке значений SpecialMethod
+        const array<string, SPECIAL_METHOD_COUNT> SPECIAL_METHOD_NAMES = {
+            "__init__"s, "__str__"s, "__eq__"s, "__lt__"s, "__add__"s,
+        };
+
+        // Значение-метка, которым заполняются слоты кадров, пока в них ничего не записано
+        class UnboundValue : public Object {
+        public:
+            void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+                os << "<unbound>"s;
+            }
+        };
+
+        UnboundValue unbound_value;
+    }  // namespace
+
+    ObjectHolder::ObjectHolder(const ObjectHolder& other)
+        : kind_(other.kind_) {
+        switch (kind_) {
+        case Kind::Empty:
+            break;
+        case Kind::Number:
+            new (&number_) Number(other.number_);
+            break;
+        case Kind::Bool:
+            new (&bool_) Bool(other.bool_);
+            break;
+        case Kind::Borrowed:
+            if (other.borrowed_->ref_count_ == 0) {
+                borrowed_ = other.borrowed_;
+                break;
+            }
+            kind_ = Kind::Owned;
+            owned_ = other.borrowed_;
+            ++owned_->ref_count_;
+            break;
+        case Kind::Owned:
+            owned_ = other.owned_;
+            ++owned_->ref_count_;
+            break;
+        }
+    }
+
+    ObjectHolder::ObjectHolder(ObjectHolder&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    ObjectHolder& ObjectHolder::operator=(const ObjectHolder& other) {
+        if (this != &other) {
+            // Копия создаётся до освобождения текущего значения: other может принадлежать
+            // объекту, которым владеет *this
+            ObjectHolder copy(other);
+            Reset();
+            MoveFrom(copy);
+        }
+        return *this;
+    }
+
+    ObjectHolder& ObjectHolder::operator=(ObjectHolder&& other) noexcept {
+        if (this != &other) {
+            ObjectHolder tmp(std::move(other));
+            Reset();
+            MoveFrom(tmp);
+        }
+        return *this;
+    }
+
+    ObjectHolder::~ObjectHolder() {
+        Reset();
+    }
+
+    void ObjectHolder::Reset() noexcept {
+        switch (kind_) {
+        case Kind::Number:
+            number_.~Number();
+            break;
+        case Kind::Bool:
+            bool_.~Bool();
+            break;
+        case Kind::Owned:
+            if (--owned_->ref_count_ == 0) {
+                delete owned_;
+            }
+            break;
+        case Kind::Empty:
+        case Kind::Borrowed:
+            break;
+        }
+        kind_ = Kind::Empty;
+    }
+
+    void ObjectHolder::MoveFrom(ObjectHolder& other) noexcept {
+        kind_ = other.kind_;
+        switch (kind_) {
+        case Kind::Empty:
+            break;
+        case Kind::Number:
+            new (&number_) Number(other.number_);
+            break;
+        case Kind::Bool:
+            new (&bool_) Bool(other.bool_);
+            break;
+        case Kind::Borrowed:
+            borrowed_ = other.borrowed_;
+            break;
+        case Kind::Owned:
+            // Владение переходит к *this, счётчик ссылок не меняется
+            owned_ = other.owned_;
+            other.kind_ = Kind::Empty;
+            return;
+        }
+        other.Reset();
+    }
+
+    void ObjectHolder::AssertIsValid() const {
+        assert(kind_ != Kind::Empty);
+    }
+
+    ObjectHolder ObjectHolder::Share(Object& object) {
+        // Невладеющая ссылка хранится как обычный указатель
+        ObjectHolder holder;
+        holder.borrowed_ = &object;
+        holder.kind_ = Kind::Borrowed;
+        return holder;
+    }
+
+    ObjectHolder ObjectHolder::Borrow(const ObjectHolder& holder) {
+        switch (holder.kind_) {
+        case Kind::Borrowed:
+        case Kind::Owned:
+            return Share(*holder.Get());
+        case Kind::Empty:
+        case Kind::Number:
+        case Kind::Bool:
+            break;
+        }
+        return holder;
+    }
+
+    ObjectHolder ObjectHolder::Retain(Object& object) {
+        if (object.ref_count_ == 0) {
+            return Share(object);
+        }
+        ObjectHolder holder;
+        holder.owned_ = &object;
+        ++object.ref_count_;
+        holder.kind_ = Kind::Owned;
+        return holder;
+    }
+
+    ObjectHolder ObjectHolder::None() {
+        return {};
+    }
+
+    Object& ObjectHolder::operator*() const {
+        AssertIsValid();
+        return *Get();
+    }
+
+    Object* ObjectHolder::operator->() const {
+        AssertIsValid();
+        return Get();
+    }
+
+    Object* ObjectHolder::Get() const {
+        switch (kind_) {
+        case Kind::Number:
+            return &number_;
+        case Kind::Bool:
+            return &bool_;
+        case Kind::Borrowed:
+            return borrowed_;
+        case Kind::Owned:
+            return owned_;
+        case Kind::Empty:
+            break;
+        }
+        return nullptr;
+    }
+
+    ObjectHolder::operator bool() const {
+        return kind_ != Kind::Empty;
+    }
+
+    size_t FrameStack::Push(size_t size) {
+        const size_t previous_base = base_;
+        base_ = top_;
+        top_ += size;
+        if (top_ > slots_.size()) {
+            slots_.resize(std::max(top_, slots_.size() * 2), ObjectHolder::Share(unbound_value));
+        }
+        return previous_base;
+    }
+
+    void FrameStack::Pop(size_t previous_base) {
+        // Освобождаемые слоты сразу возвращаются в исходное состояние,
+        // поэтому выделение следующего кадра сводится к сдвигу вершины стека
+        for (size_t i = base_; i < top_; ++i) {
+            slots_[i] = ObjectHolder::Share(unbound_value);
+        }
+        top_ = base_;
+        base_ = previous_base;
+    }
+
+    bool FrameStack::IsUnbound(const ObjectHolder& value) {
+        return value.Get() == &unbound_value;
+    }
+
+    bool IsTrue(const ObjectHolder& object) {
+        switch (object.GetKind()) {
+        case ObjectKind::Bool:
+            return object.TryAs<Bool>()->GetValue();
+        case ObjectKind::Number:
+            return object.TryAs<Number>()->GetValue() != 0;
+        case ObjectKind::String:
+            return !object.TryAs<String>()->GetValue().empty();
+        case ObjectKind::None:
+        case ObjectKind::Class:
+        case ObjectKind::ClassInstance:
+            return false;
+        case ObjectKind::Other:
+            break;
+        }
+        return true;
+    }
+
+    ClassInstance::ClassInstance(const Class& cls)
+        : Object(ObjectKind::ClassInstance)
+        , class_(cls)
+        , shape_(&cls.GetRootShape()) {
+        CycleCollector::GetInstance().Track(this);
+    }
+
+    ClassInstance::ClassInstance(const ClassInstance& other)
+        : Object(other)
+        , class_(other.class_)
+        , shape_(other.shape_)
+        , fields_(other.fields_) {
+        CycleCollector::GetInstance().Track(this);
+    }
+
+    ClassInstance::ClassInstance(ClassInstance&& other) noexcept
+        : Object(other)
+        , class_(other.class_)
+        , shape_(other.shape_)
+        , fields_(std::move(other.fields_)) {
+        other.shape_ = &class_.GetRootShape();
+        CycleCollector::GetInstance().Track(this);
+    }
+
+    ClassInstance::~ClassInstance() {
+        CycleCollector::GetInstance().Untrack(this);
+    }
+
+    void ClassInstance::Print(std::ostream& os, Context& context) {
+        if (const Method* str = GetSpecialMethod(SpecialMethod::Str, 0)) {
+            Call(*str, {}, context)->Print(os, context);
+        }
+        else {
+            os << this;
+        }
+    }
+
+    bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
+        auto* tmp_method = class_.GetMethod(method);
+        return tmp_method && tmp_method->formal_params.size() == argument_count;
+    }
+
+    ObjectHolder ClassInstance::Create(const Class& cls) {
+        CycleCollector::GetInstance().MaybeCollect();
+        return ObjectHolder::Make<ClassInstance>(cls);
+    }
+
+    void* ClassInstance::operator new(size_t size) {
+        return SlabPool::GetInstance().Allocate(size);
+    }
+
+    void ClassInstance::operator delete(void* ptr, size_t size) noexcept {
+        SlabPool::GetInstance().Deallocate(ptr, size);
+    }
+
+    ObjectHolder* ClassInstance::FindField(const std::string& name) {
+        const size_t index = shape_->Find(name);
+        return index == Shape::NOT_FOUND ? nullptr : &fields_[index];
+    }
+
+    const ObjectHolder* ClassInstance::FindField(const std::string& name) const {
+        const size_t index = shape_->Find(name);
+        return index == Shape::NOT_FOUND ? nullptr : &fields_[index];
+    }
+
+    ObjectHolder& ClassInstance::SetField(const std::string& name, ObjectHolder value) {
+        if (ObjectHolder* field = FindField(name)) {
+            *field = std::move(value);
+            return *field;
+        }
+        return AddField(*shape_->AddField(name), std::move(value));
+    }
+
+    const Shape& ClassInstance::GetShape() const {
+        return *shape_;
+    }
+
+    ObjectHolder& ClassInstance::FieldAt(size_t index) {
+        return fields_[index];
+    }
+
+    const ObjectHolder& ClassInstance::FieldAt(size_t index) const {
+        return fields_[index];
+    }
+
+    ObjectHolder& ClassInstance::AddField(const Shape& next, ObjectHolder value) {
+        shape_ = &next;
+        return fields_.emplace_back(std::move(value));
+    }
+
+    const Class& ClassInstance::GetClass() const {
+        return class_;
+    }
+
+    ObjectHolder ClassInstance::Call(const std::string& method,
+        const std::vector<ObjectHolder>& actual_args,
+        Context& context) {
+        if (!HasMethod(method, actual_args.size())) {
+            throw std::runtime_error("Method not found."s);
+        }
+        auto* tmp_method = class_.GetMethod(method);
+        return Call(*tmp_method, actual_args, context);
+    }
+
+    ObjectHolder ClassInstance::Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
+        Context& context) {
+        // self удерживает объект: метод может вернуть self, пережив временный объект,
+        // у которого он вызван
+        return method.body->Invoke(method, ObjectHolder::Retain(*this), actual_args, context);
+    }
+
+    const Method* ClassInstance::GetSpecialMethod(SpecialMethod method, size_t argument_count) const {
+        const Method* special = class_.GetSpecialMethod(method);
+        return special != nullptr && special->formal_params.size() == argument_count ? special : nullptr;
+    }
+
+    void* Executable::operator new(size_t size) {
+        return AllocateInArena(size);
+    }
+
+    void Executable::operator delete(void* ptr) noexcept {
+        FreeInArena(ptr);
+    }
+
+    const ObjectHolder& Executable::Borrow(Closure& closure, Context& context, ObjectHolder& temp) {
+        temp = Execute(closure, context);
+        return temp;
+    }
+
+    ObjectHolder Executable::Invoke(const Method& method, const ObjectHolder& self,
+        const std::vector<ObjectHolder>& args, Context& context) {
+        Closure tmp_closure;
+        tmp_closure["self"s] = self;
+        for (size_t i = 0; i < method.formal_params.size(); ++i) {
+            tmp_closure[method.formal_params.at(i)] = args.at(i);
+        }
+        return Execute(tmp_closure, context);
+    }
+
+    Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
+        : Object(ObjectKind::Class), name_(std::move(name)), methods_(std::move(methods)), parent_(parent) {
+        BuildMethodTable();
+    }
+
+    void Class::Define(std::vector<Method> methods, const Class* parent) {
+        methods_ = std::move(methods);
+        parent_ = parent;
+        BuildMethodTable();
+    }
+
+    void Class::BuildMethodTable() {
+        method_table_.clear();
+        special_methods_ = {};
+        if (parent_) {
+            method_table_ = parent_->method_table_;
+            special_methods_ = parent_->special_methods_;
+        }
+        for (const auto& met : methods_) {
+            method_table_[met.name] = &met;
+        }
+        for (size_t i = 0; i < SPECIAL_METHOD_NAMES.size(); ++i) {
+            if (const auto it = method_table_.find(SPECIAL_METHOD_NAMES[i]); it != method_table_.end()) {
+                special_methods_[i] = it->second;
+            }
+        }
+    }
+
+    const Method* Class::GetMethod(const std::string& name) const {
+        const auto it = method_table_.find(name);
+        return it != method_table_.end() ? it->second : nullptr;
+    }
+
+    [[nodiscard]] const std::string& Class::GetName() const {
+        return name_;
+    }
+
+    [[nodiscard]] const Class* Class::GetParent() const {
+        return parent_;
+    }
+
+    std::vector<Method>& Class::Methods() {
+        return methods_;
+    }
+
+    const std::vector<Method>& Class::Methods() const {
+        return methods_;
+    }
+
+    const Shape& Class::GetRootShape() const {
+        return *root_shape_;
+    }
+
+    size_t Shape::Find(const std::string& name) const {
+        if (!index_.empty()) {
+            const auto it = index_.find(name);
+            return it == index_.end() ? NOT_FOUND : it->second;
+        }
+        for (size_t i = 0; i < names_.size(); ++i) {
+            if (names_[i] == name) {
+                return i;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    const Shape* Shape::AddField(const std::string& name) const {
+        auto& next = transitions_[name];
+        if (!next) {
+            next = std::make_unique<Shape>();
+            next->names_ = names_;
+            next->names_.push_back(name);
+            if (next->names_.size() >= INDEX_THRESHOLD) {
+                for (size_t i = 0; i < next->names_.size(); ++i) {
+                    next->index_.emplace(next->names_[i], i);
+                }
+            }
+        }
+        return next.get();
+    }
+
+    size_t Shape::GetFieldCount() const {
+        return names_.size();
+    }
+
+    const std::string& Shape::GetFieldName(size_t index) const {
+        return names_[index];
+    }
+
+    FieldCache::Entry FieldCache::Lookup(const Shape& shape, const std::string& name, bool adding) {
+        for (size_t i = 0; i < size_; ++i) {
+            Entry& entry = entries_[i];
+            if (entry.shape == &shape) {
+                ++hits_;
+                if (adding && entry.index == Shape::NOT_FOUND && entry.next == nullptr) {
+                    entry.next = shape.AddField(name);
+                }
+                return entry;
+            }
+        }
+        ++misses_;
+        Entry entry{ &shape, shape.Find(name), nullptr };
+        if (adding && entry.index == Shape::NOT_FOUND) {
+            entry.next = shape.AddField(name);
+        }
+        if (size_ < CAPACITY) {
+            entries_[size_++] = entry;
+        }
+        return entry;
+    }
+
+    const ObjectHolder* FieldCache::Get(const ClassInstance& instance, const std::string& name) {
+        const Entry entry = Lookup(instance.GetShape(), name, false);
+        return entry.index == Shape::NOT_FOUND ? nullptr : &instance.FieldAt(entry.index);
+    }
+
+    ObjectHolder& FieldCache::Set(ClassInstance& instance, const std::string& name, ObjectHolder value) {
+        const Entry entry = Lookup(instance.GetShape(), name, true);
+        if (entry.index == Shape::NOT_FOUND) {
+            return instance.AddField(*entry.next, std::move(value));
+        }
+        ObjectHolder& field = instance.FieldAt(entry.index);
+        field = std::move(value);
+        return field;
+    }
+
+    size_t FieldCache::GetHits() const {
+        return hits_;
+    }
+
+    size_t FieldCache::GetMisses() const {
+        return misses_;
+    }
+
+    void Class::Print(ostream& os, [[maybe_unused]] Context& context) {
+        os << "Class "sv << name_;
+    }
+
+    void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
+        os << (GetValue() ? "True"sv : "False"sv);
+    }
+
+    // Сравнивает числа, строки и логические значения одного типа.
+    // Для значений других типов возвращает nullopt
+    template<typename C>
+    std::optional<bool> Comp(const ObjectHolder& lhs, const ObjectHolder& rhs, C pred = C{}) {
+        const ObjectKind kind = lhs.GetKind();
+        if (kind != rhs.GetKind()) {
+            return std::nullopt;
+        }
+        switch (kind) {
+        case ObjectKind::Bool:
+            return pred(lhs.TryAs<Bool>()->GetValue(), rhs.TryAs<Bool>()->GetValue());
+        case ObjectKind::Number:
+            return pred(lhs.TryAs<Number>()->GetValue(), rhs.TryAs<Number>()->GetValue());
+        case ObjectKind::String:
+            return pred(lhs.TryAs<String>()->GetValue(), rhs.TryAs<String>()->GetValue());
+        default:
+            return std::nullopt;
+        }
+    }
+
+    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        if (const auto result = Comp(lhs, rhs, std::equal_to<>{})) {
+            return *result;
+        }
+        auto* instance = lhs.TryAs<ClassInstance>();
+        if (const Method* eq = instance ? instance->GetSpecialMethod(SpecialMethod::Eq, 1) : nullptr) {
+            return instance->Call(*eq, { rhs }, context).TryAs<Bool>()->GetValue();
+        }
+        if (!lhs.operator bool() && !rhs.operator bool()) {
+            return true;
+        }
+        throw std::runtime_error("Cannot compare objects for equal"s);
+    }
+
+    bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        if (const auto result = Comp(lhs, rhs, std::less<>{})) {
+            return *result;
+        }
+        auto* instance = lhs.TryAs<ClassInstance>();
+        if (const Method* lt = instance ? instance->GetSpecialMethod(SpecialMethod::Lt, 1) : nullptr) {
+            return instance->Call(*lt, { rhs }, context).TryAs<Bool>()->GetValue();
+        }
+        throw std::runtime_error("Cannot compare objects for less"s);
+    }
+
+    ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        const ObjectKind kind = lhs.GetKind();
+        if (kind == rhs.GetKind()) {
+            if (kind == ObjectKind::Number) {
+                int number = lhs.TryAs<Number>()->GetValue() + rhs.TryAs<Number>()->GetValue();
+                return ObjectHolder::Own(Number{ number });
+            }
+            if (kind == ObjectKind::String) {
+                string str = lhs.TryAs<String>()->GetValue() + rhs.TryAs<String>()->GetValue();
+                return ObjectHolder::Own(String{ std::move(str) });
+            }
+        }
+
+        if (kind == ObjectKind::ClassInstance) {
+            auto lhs_instance = lhs.TryAs<ClassInstance>();
+            if (const Method* add = lhs_instance->GetSpecialMethod(SpecialMethod::Add, 1)) {
+                return lhs_instance->Call(*add, { rhs }, context);
+            }
+        }
+
+        throw std::runtime_error("No __add__ method"s);
+    }
+
+    ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        auto lhs_number = lhs.TryAs<Number>();
+        auto rhs_number = rhs.TryAs<Number>();
+        if (lhs_number != nullptr && rhs_number != nullptr) {
+            int number = lhs_number->GetValue() - rhs_number->GetValue();
+            return ObjectHolder::Own(Number{ number });
+        }
+
+        throw std::runtime_error("lhs or rhs not Number"s);
+    }
+
+    ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        auto lhs_number = lhs.TryAs<Number>();
+        auto rhs_number = rhs.TryAs<Number>();
+        if (lhs_number != nullptr && rhs_number != nullptr) {
+            int number = lhs_number->GetValue() * rhs_number->GetValue();
+            return ObjectHolder::Own(Number{ number });
+        }
+
+        throw std::runtime_error("lhs or rhs not Number"s);
+    }
+
+    ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        auto lhs_number = lhs.TryAs<Number>();
+        auto rhs_number = rhs.TryAs<Number>();
+        if (lhs_number != nullptr && rhs_number != nullptr) {
+            if (rhs_number->GetValue() == 0) {
+                throw std::runtime_error("Division by zero"s);
+            }
+
+            int number = lhs_number->GetValue() / rhs_number->GetValue();
+            return ObjectHolder::Own(Number{ number });
+        }
+
+        throw std::runtime_error("lhs or rhs not Number"s);
+    }
+
+    bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        return !Equal(lhs, rhs, context);
+    }
+
+    bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        return !(Less(lhs, rhs, context) || Equal(lhs, rhs, context));
+    }
+
+    bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        return !Greater(lhs, rhs, context);
+    }
+
+    bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+        return !Less(lhs, rhs, context);
+    }
+
+}  // namespace runtime
@@ -1,261 +1,717 @@
-#pragma once
-
-#include <memory>
-#include <sstream>
-#include <string>
-#include <unordered_map>
-#include <utility>
-#include <vector>
-
-namespace runtime {
-
-    // Контекст исполнения инструкций Mython
-    class Context {
-    public:
-        // Возвращает поток вывода для команд print
-        virtual std::ostream& GetOutputStream() = 0;
-
-        void SetSelfName(std::string self_name) {
-            self_name_ = std::move(self_name);
-        }
-
-        [[nodiscard]] const std::string& GetSelfName() const {
-            return self_name_;
-        }
-
-    protected:
-        ~Context() = default;
-
-    private:
-        std::string self_name_;
-    };
-
-    // Базовый класс для всех объектов языка Mython
-    class Object {
-    public:
-        virtual ~Object() = default;
-
-        // выводит в os своё представление в виде строки
-        virtual void Print(std::ostream& os, Context& context) = 0;
-    };
-
-    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
-    class ObjectHolder {
-    public:
-        // Создаёт пустое значение
-        ObjectHolder() = default;
-
-        // Возвращает ObjectHolder, владеющий объектом типа T
-        // Тип T - конкретный класс-наследник Object.
-        // object копируется или перемещается в кучу
-        template<typename T>
-        [[nodiscard]] static ObjectHolder Own(T&& object) {
-            return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
-        }
-
-        // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
-        [[nodiscard]] static ObjectHolder Share(Object& object);
-
-        // Создаёт пустой ObjectHolder, соответствующий значению None
-        [[nodiscard]] static ObjectHolder None();
-
-        // Возвращает ссылку на Object внутри ObjectHolder.
-        // ObjectHolder должен быть непустым
-        Object& operator*() const;
-
-        Object* operator->() const;
-
-        [[nodiscard]] Object* Get() const;
-
-        // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-        // объект данного типа
-        template<typename T>
-        [[nodiscard]] T* TryAs() const {
-            return dynamic_cast<T*>(this->Get());
-        }
-
-        // Возвращает true, если ObjectHolder не пуст
-        explicit operator bool() const;
-
-    private:
-        explicit ObjectHolder(std::shared_ptr<Object> data);
-
-        void AssertIsValid() const;
-
-        std::shared_ptr<Object> data_;
-    };
-
-    // Объект-значение, хранящий значение типа T
-    template<typename T>
-    class ValueObject : public Object {
-    public:
-        ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-            : value_(v) {
-        }
-
-        void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
-            os << value_;
-        }
-
-        [[nodiscard]] const T& GetValue() const {
-            return value_;
-        }
-
-    private:
-        T value_;
-    };
-
-    // Таблица символов, связывающая имя объекта с его значением
-    using Closure = std::unordered_map<std::string, ObjectHolder>;
-
-    // Проверяет, содержится ли в object значение, приводимое к True
-    // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
-    bool IsTrue(const ObjectHolder& object);
-
-    // Интерфейс для выполнения действий над объектами Mython
-    class Executable {
-    public:
-        virtual ~Executable() = default;
-
-        // Выполняет действие над объектами внутри closure, используя context
-        // Возвращает результирующее значение либо None
-        virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
-    };
-
-    // Строковое значение
-    using String = ValueObject<std::string>;
-    // Числовое значение
-    using Number = ValueObject<int>;
-
-    // Логическое значение
-    class Bool : public ValueObject<bool> {
-    public:
-        using ValueObject<bool>::ValueObject;
-
-        void Print(std::ostream& os, Context& context) override;
-    };
-
-    // Метод класса
-    struct Method {
-        // Имя метода
-        std::string name;
-        // Имена формальных параметров метода
-        std::vector<std::string> formal_params;
-        // Тело метода
-        std::unique_ptr<Executable> body;
-    };
-
-    // Класс
-    class Class : public Object {
-    public:
-        // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
-        // Если parent равен nullptr, то создаётся базовый класс
-        explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
-
-        // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-        [[nodiscard]] const Method* GetMethod(const std::string& name) const;
-
-        // Возвращает имя класса
-        [[nodiscard]] const std::string& GetName() const;
-
-        // Выводит в os строку "Class <имя класса>", например "Class cat"
-        void Print(std::ostream& os, Context& context) override;
-
-    private:
-        std::string name_;
-        std::vector<Method> methods_;
-        const Class* parent_;
-    };
-
-    // Экземпляр класса
-    class ClassInstance : public Object {
-    public:
-        explicit ClassInstance(const Class& cls);
-
-        /*
-         * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
-         * В противном случае в os выводится адрес объекта.
-         */
-        void Print(std::ostream& os, Context& context) override;
-
-        /*
-         * Вызывает у объекта метод method, передавая ему actual_args параметров.
-         * Параметр context задаёт контекст для выполнения метода.
-         * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
-         * runtime_error
-         */
-        ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
-            Context& context);
-
-        // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-        [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
-
-        // Возвращает ссылку на Closure, содержащий поля объекта
-        [[nodiscard]] Closure& Fields();
-
-        // Возвращает константную ссылку на Closure, содержащую поля объекта
-        [[nodiscard]] const Closure& Fields() const;
-
-    private:
-        const Class& class_;
-        Closure closure_;
-    };
-
-    /*
-     * Возвращает true, если lhs и rhs содержат одинаковые числа, строки или значения типа Bool.
-     * Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs),
-     * приведённый к типу Bool. Если lhs и rhs имеют значение None, функция возвращает true.
-     * В остальных случаях функция выбрасывает исключение runtime_error.
-     *
-     * Параметр context задаёт контекст для выполнения метода __eq__
-     */
-    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-    /*
-     * Если lhs и rhs - числа, строки или значения bool, функция возвращает результат их сравнения
-     * оператором <.
-     * Если lhs - объект с методом __lt__, возвращает результат вызова lhs.__lt__(rhs),
-     * приведённый к типу bool. В остальных случаях функция выбрасывает исключение runtime_error.
-     *
-     * Параметр context задаёт контекст для выполнения метода __lt__
-     */
-    bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-    // Возвращает значение, противоположное Equal(lhs, rhs, context)
-    bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-    // Возвращает значение lhs>rhs, используя функции Equal и Less
-    bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-    // Возвращает значение lhs<=rhs, используя функции Equal и Less
-    bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-    // Возвращает значение, противоположное Less(lhs, rhs, context)
-    bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-    // Контекст-заглушка, применяется в тестах.
-    // В этом контексте весь вывод перенаправляется в строковый поток вывода output
-    struct DummyContext : Context {
-        std::ostream& GetOutputStream() override {
-            return output;
-        }
-
-        std::ostringstream output;
-    };
-
-    // Простой контекст, в нём вывод происходит в поток output, переданный в конструктор
-    class SimpleContext : public runtime::Context {
-    public:
-        explicit SimpleContext(std::ostream& output)
-            : output_(output) {
-        }
-
-        std::ostream& GetOutputStream() override {
-            return output_;
-        }
-
-    private:
-        std::ostream& output_;
-    };
-
-}  // namespace runtime
+#pragma once
+
+#include "collector.h"
+#include "slab.h"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace runtime {
+
+    class Context;
+    struct Method;
+    class Class;
+    class ClassInstance;
+
+    // Разновидность объекта. Позволяет проверять тип объекта сравнением целых чисел
+    // вместо dynamic_cast
+    enum class ObjectKind : std::uint8_t {
+        None,           // пустой ObjectHolder
+        Number,
+        String,
+        Bool,
+        Class,
+        ClassInstance,
+        Other,          // прочие наследники Object
+    };
+
+    // Базовый класс для всех объектов языка Mython.
+    // Объект, размещённый в куче, хранит число владеющих им ObjectHolder и удаляется,
+    // когда оно становится равным нулю
+    class Object {
+    public:
+        virtual ~Object() = default;
+
+        // выводит в os своё представление в виде строки
+        virtual void Print(std::ostream& os, Context& context) = 0;
+
+        [[nodiscard]] ObjectKind GetKind() const {
+            return kind_;
+        }
+
+    protected:
+        Object() = default;
+
+        explicit Object(ObjectKind kind)
+            : kind_(kind) {
+        }
+
+        // Копия объекта - новый объект, владельцы оригинала на неё не переносятся
+        Object(const Object& other)
+            : kind_(other.kind_) {
+        }
+
+        Object& operator=([[maybe_unused]] const Object& other) {
+            return *this;
+        }
+
+    private:
+        friend class ObjectHolder;
+        friend class CycleCollector;
+
+        ObjectKind kind_ = ObjectKind::Other;
+        // Счётчик не атомарный: программа выполняется в одном потоке, а объекты, созданные
+        // при параллельном разборе, передаются выполняющему потоку целиком
+        std::uint32_t ref_count_ = 0;
+    };
+
+    // Объект-значение, хранящий значение типа T
+    template<typename T>
+    class ValueObject : public Object {
+    public:
+        ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            : Object(std::is_same_v<T, int> ? ObjectKind::Number
+                : std::is_same_v<T, std::string> ? ObjectKind::String : ObjectKind::Other)
+            , value_(v) {
+        }
+
+        void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+            os << value_;
+        }
+
+        [[nodiscard]] const T& GetValue() const {
+            return value_;
+        }
+
+    protected:
+        ValueObject(T v, ObjectKind kind)
+            : Object(kind)
+            , value_(v) {
+        }
+
+    private:
+        T value_;
+    };
+
+    // Строковое значение
+    using String = ValueObject<std::string>;
+    // Числовое значение
+    using Number = ValueObject<int>;
+
+    // Логическое значение
+    class Bool : public ValueObject<bool> {
+    public:
+        Bool(bool v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            : ValueObject<bool>(v, ObjectKind::Bool) {
+        }
+
+        void Print(std::ostream& os, Context& context) override;
+    };
+
+    // Разновидность объектов типа T либо ObjectKind::Other, если её нельзя определить по типу
+    template <typename T>
+    inline constexpr ObjectKind OBJECT_KIND = ObjectKind::Other;
+    template <>
+    inline constexpr ObjectKind OBJECT_KIND<Number> = ObjectKind::Number;
+    template <>
+    inline constexpr ObjectKind OBJECT_KIND<String> = ObjectKind::String;
+    template <>
+    inline constexpr ObjectKind OBJECT_KIND<Bool> = ObjectKind::Bool;
+    template <>
+    inline constexpr ObjectKind OBJECT_KIND<Class> = ObjectKind::Class;
+    template <>
+    inline constexpr ObjectKind OBJECT_KIND<ClassInstance> = ObjectKind::ClassInstance;
+
+    /*
+     * Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+     * Числа, логические значения и None хранятся непосредственно внутри ObjectHolder
+     * и не требуют ни выделения памяти, ни подсчёта ссылок. В куче размещаются только
+     * строки, классы и их экземпляры
+     */
+    class ObjectHolder {
+    public:
+        // Создаёт пустое значение
+        ObjectHolder() noexcept {
+        }
+
+        ObjectHolder(const ObjectHolder& other);
+        ObjectHolder(ObjectHolder&& other) noexcept;
+        ObjectHolder& operator=(const ObjectHolder& other);
+        ObjectHolder& operator=(ObjectHolder&& other) noexcept;
+        ~ObjectHolder();
+
+        // Возвращает ObjectHolder, владеющий объектом типа T
+        // Тип T - конкретный класс-наследник Object.
+        // Number и Bool копируются внутрь ObjectHolder, остальные объекты копируются
+        // или перемещаются в кучу
+        template<typename T>
+        [[nodiscard]] static ObjectHolder Own(T&& object) {
+            using Type = std::decay_t<T>;
+            ObjectHolder holder;
+            if constexpr (std::is_same_v<Type, Number>) {
+                new (&holder.number_) Number(std::forward<T>(object));
+                holder.kind_ = Kind::Number;
+            }
+            else if constexpr (std::is_same_v<Type, Bool>) {
+                new (&holder.bool_) Bool(std::forward<T>(object));
+                holder.kind_ = Kind::Bool;
+            }
+            else {
+                return Make<Type>(std::forward<T>(object));
+            }
+            return holder;
+        }
+
+        // Создаёт в куче объект типа T из аргументов args и возвращает владеющий им ObjectHolder.
+        // В отличие от Own, объект конструируется сразу на своём месте, без промежуточной копии
+        template<typename T, typename... Args>
+        [[nodiscard]] static ObjectHolder Make(Args&&... args) {
+            ObjectHolder holder;
+            holder.owned_ = new T(std::forward<Args>(args)...);
+            ++holder.owned_->ref_count_;
+            holder.kind_ = Kind::Owned;
+            return holder;
+        }
+
+        // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки).
+        // Копия такого ObjectHolder владеет объектом, если он размещён в куче (см. Retain),
+        // поэтому значение, скопированное из невладеющего ObjectHolder, не зависит от оригинала
+        [[nodiscard]] static ObjectHolder Share(Object& object);
+
+        // Возвращает значение holder, не увеличивая счётчик ссылок: числа и логические значения
+        // копируются, на прочие объекты создаётся невладеющая ссылка. Ссылка действительна,
+        // пока объект не освобождён владельцами holder
+        [[nodiscard]] static ObjectHolder Borrow(const ObjectHolder& holder);
+
+        // Создаёт ObjectHolder, владеющий object наравне с другими владельцами, если объект
+        // размещён в куче вызовом Own. Для прочих объектов работает как Share
+        [[nodiscard]] static ObjectHolder Retain(Object& object);
+
+        // Создаёт пустой ObjectHolder, соответствующий значению None
+        [[nodiscard]] static ObjectHolder None();
+
+        // Возвращает ссылку на Object внутри ObjectHolder.
+        // ObjectHolder должен быть непустым
+        Object& operator*() const;
+
+        Object* operator->() const;
+
+        // Возвращает указатель на хранимый объект. Для чисел и логических значений указатель
+        // ссылается внутрь ObjectHolder и действителен, пока ObjectHolder не изменён
+        [[nodiscard]] Object* Get() const;
+
+        // Возвращает разновидность хранимого объекта, для пустого ObjectHolder - ObjectKind::None
+        [[nodiscard]] ObjectKind GetKind() const {
+            switch (kind_) {
+            case Kind::Number:
+                return ObjectKind::Number;
+            case Kind::Bool:
+                return ObjectKind::Bool;
+            case Kind::Borrowed:
+                return borrowed_->GetKind();
+            case Kind::Owned:
+                return owned_->GetKind();
+            case Kind::Empty:
+                break;
+            }
+            return ObjectKind::None;
+        }
+
+        // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
+        // объект данного типа. Для типов, имеющих собственную разновидность ObjectKind,
+        // проверка сводится к сравнению разновидностей
+        template<typename T>
+        [[nodiscard]] T* TryAs() const {
+            if constexpr (std::is_same_v<T, Number>) {
+                if (kind_ == Kind::Number) {
+                    return &number_;
+                }
+            }
+            else if constexpr (std::is_same_v<T, Bool>) {
+                if (kind_ == Kind::Bool) {
+                    return &bool_;
+                }
+            }
+            if (kind_ == Kind::Empty) {
+                return nullptr;
+            }
+            if constexpr (OBJECT_KIND<T> != ObjectKind::Other) {
+                Object* object = Get();
+                return object->GetKind() == OBJECT_KIND<T> ? static_cast<T*>(object) : nullptr;
+            }
+            else {
+                return dynamic_cast<T*>(this->Get());
+            }
+        }
+
+        // Возвращает true, если ObjectHolder не пуст
+        explicit operator bool() const;
+
+    private:
+        friend class CycleCollector;
+
+        enum class Kind : std::uint8_t {
+            Empty,
+            Number,
+            Bool,
+            Borrowed,
+            Owned,
+        };
+
+        void AssertIsValid() const;
+
+        void Reset() noexcept;
+        void MoveFrom(ObjectHolder& other) noexcept;
+
+        Kind kind_ = Kind::Empty;
+        union {
+            mutable Number number_;
+            mutable Bool bool_;
+            Object* borrowed_;
+            Object* owned_;
+        };
+    };
+
+    /*
+     * Стек кадров вызовов методов. Кадр - непрерывный участок из фиксированного числа слотов,
+     * в которых хранятся self, параметры и локальные переменные метода. Номера слотов
+     * назначаются переменным после разбора программы (см. ast::ResolveSlots), поэтому
+     * обращение к локальной переменной сводится к индексации в текущем кадре
+     */
+    class FrameStack {
+    public:
+        // Кадр, освобождаемый при выходе из области видимости
+        class ScopedFrame {
+        public:
+            ScopedFrame(FrameStack& stack, size_t size)
+                : stack_(stack)
+                , previous_base_(stack.Push(size)) {
+            }
+
+            ScopedFrame(const ScopedFrame&) = delete;
+            ScopedFrame& operator=(const ScopedFrame&) = delete;
+
+            ~ScopedFrame() {
+                stack_.Pop(previous_base_);
+            }
+
+        private:
+            FrameStack& stack_;
+            size_t previous_base_;
+        };
+
+        // Выделяет на вершине стека кадр из size слотов и делает его текущим.
+        // В слоты нового кадра ещё не записано значений (см. IsUnbound).
+        // Возвращает начало предыдущего кадра, которое нужно передать в Pop
+        size_t Push(size_t size);
+
+        // Освобождает текущий кадр и делает текущим кадр, начинающийся с previous_base
+        void Pop(size_t previous_base);
+
+        // Возвращает слот текущего кадра. Ссылка действительна, пока кадр не освобождён
+        ObjectHolder& operator[](size_t slot) {
+            return slots_[base_ + slot];
+        }
+
+        // Возвращает true, если в слот кадра ещё не было записано значение
+        [[nodiscard]] static bool IsUnbound(const ObjectHolder& value);
+
+    private:
+        // Слоты хранятся в deque, чтобы рост стека при вложенных вызовах
+        // не инвалидировал ссылки на слоты вызывающих кадров
+        std::deque<ObjectHolder> slots_;
+        size_t base_ = 0;
+        size_t top_ = 0;
+    };
+
+    // Контекст исполнения инструкций Mython
+    class Context {
+    public:
+        // Возвращает поток вывода для команд print
+        virtual std::ostream& GetOutputStream() = 0;
+
+        void SetSelfName(std::string self_name) {
+            self_name_ = std::move(self_name);
+        }
+
+        [[nodiscard]] const std::string& GetSelfName() const {
+            return self_name_;
+        }
+
+        // Запоминает результат выполненной инструкции return. Пока значение не забрано
+        // методом TakeReturnValue, составные инструкции прекращают своё выполнение
+        void SetReturnValue(ObjectHolder value) {
+            return_value_ = std::move(value);
+            returning_ = true;
+        }
+
+        // Возвращает true, если выполнена инструкция return, результат которой ещё не забран
+        [[nodiscard]] bool IsReturning() const {
+            return returning_;
+        }
+
+        // Возвращает результат инструкции return и сбрасывает признак возврата
+        ObjectHolder TakeReturnValue() {
+            returning_ = false;
+            return std::move(return_value_);
+        }
+
+        // Возвращает стек кадров выполняемых методов
+        FrameStack& GetFrames() {
+            return frames_;
+        }
+
+    protected:
+        ~Context() = default;
+
+    private:
+        std::string self_name_;
+        ObjectHolder return_value_;
+        bool returning_ = false;
+        FrameStack frames_;
+    };
+
+    // Таблица символов, связывающая имя объекта с его значением
+    using Closure = std::unordered_map<std::string, ObjectHolder>;
+
+    // Проверяет, содержится ли в object значение, приводимое к True
+    // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
+    bool IsTrue(const ObjectHolder& object);
+
+    // Интерфейс для выполнения действий над объектами Mython
+    class Executable {
+    public:
+        virtual ~Executable() = default;
+
+        // Узлы, созданные внутри Arena::Scope, размещаются в арене программы
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr) noexcept;
+
+        // Выполняет действие над объектами внутри closure, используя context
+        // Возвращает результирующее значение либо None
+        virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
+
+        // Вычисляет значение, не создавая владеющей копии, если оно уже хранится в closure,
+        // слоте кадра или поле объекта, и возвращает ссылку на хранимое значение. Иначе
+        // помещает результат Execute в temp и возвращает ссылку на temp. Заимствованная
+        // ссылка действительна, пока не изменено хранилище, поэтому значение, которое
+        // сохраняется, возвращается или передаётся в метод, нужно копировать.
+        // Используется только при обходе дерева: виртуальная машина читает операнды
+        // прямо из регистров, а переменные и поля копирует в регистры LoadGlobal и GetField
+        virtual const ObjectHolder& Borrow(Closure& closure, Context& context, ObjectHolder& temp);
+
+        // Возвращает true, если выполнение не исполняет код программы и не изменяет
+        // переменных и полей объектов, как чтение переменной или константа
+        [[nodiscard]] virtual bool IsSideEffectFree() const {
+            return false;
+        }
+
+        // Выполняет действие как тело метода method объекта self с фактическими параметрами args.
+        // По умолчанию помещает self и параметры в новый Closure и вызывает Execute.
+        // Тела, хранящие переменные в кадрах, переопределяют метод и обходятся без Closure
+        virtual ObjectHolder Invoke(const Method& method, const ObjectHolder& self,
+            const std::vector<ObjectHolder>& args, Context& context);
+    };
+
+    // Метод класса
+    struct Method {
+        // Имя метода
+        std::string name;
+        // Имена формальных параметров метода
+        std::vector<std::string> formal_params;
+        // Тело метода
+        std::unique_ptr<Executable> body;
+    };
+
+    // Специальные методы, которые интерпретатор вызывает неявно
+    enum class SpecialMethod {
+        Init,  // __init__
+        Str,   // __str__
+        Eq,    // __eq__
+        Lt,    // __lt__
+        Add,   // __add__
+    };
+
+    constexpr size_t SPECIAL_METHOD_COUNT = 5;
+
+    /*
+     * Форма (скрытый класс) экземпляра: упорядоченный список имён его полей.
+     * Экземпляры, получившие одни и те же поля в одном и том же порядке, разделяют одну форму
+     * и хранят значения полей в векторе по её индексам. Добавление поля переводит экземпляр
+     * в дочернюю форму, переходы запоминаются в родительской форме
+     */
+    class Shape {
+    public:
+        static constexpr size_t NOT_FOUND = std::numeric_limits<size_t>::max();
+
+        Shape() = default;
+        Shape(const Shape&) = delete;
+        Shape& operator=(const Shape&) = delete;
+
+        // Возвращает индекс поля name или NOT_FOUND, если в форме нет такого поля
+        [[nodiscard]] size_t Find(const std::string& name) const;
+
+        // Возвращает форму, получающуюся из этой добавлением поля name в конец.
+        // Поле name не должно присутствовать в форме
+        [[nodiscard]] const Shape* AddField(const std::string& name) const;
+
+        [[nodiscard]] size_t GetFieldCount() const;
+        [[nodiscard]] const std::string& GetFieldName(size_t index) const;
+
+    private:
+        // Начиная с этого количества полей поиск идёт по хеш-таблице, а не перебором
+        static constexpr size_t INDEX_THRESHOLD = 8;
+
+        std::vector<std::string> names_;
+        std::unordered_map<std::string, size_t> index_;
+        mutable std::unordered_map<std::string, std::unique_ptr<Shape>> transitions_;
+    };
+
+    // Класс
+    class Class : public Object {
+    public:
+        // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
+        // Если parent равен nullptr, то создаётся базовый класс.
+        // Таблица методов строится сразу и включает унаследованные методы, поэтому
+        // поиск метода не зависит от глубины иерархии
+        explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
+
+        // Заменяет методы и родителя класса и перестраивает таблицу методов. Позволяет создать
+        // объект класса до того, как разобраны его методы. Классы-наследники, построенные
+        // раньше, таблицу не обновляют
+        void Define(std::vector<Method> methods, const Class* parent);
+
+        // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
+        [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+
+        // Возвращает указатель на специальный метод или nullptr, если ни класс,
+        // ни его родители его не содержат
+        [[nodiscard]] const Method* GetSpecialMethod(SpecialMethod method) const {
+            return special_methods_[static_cast<size_t>(method)];
+        }
+
+        // Возвращает имя класса
+        [[nodiscard]] const std::string& GetName() const;
+
+        // Возвращает родительский класс или nullptr для базового класса
+        [[nodiscard]] const Class* GetParent() const;
+
+        // Возвращает методы, объявленные непосредственно в классе (без методов родителя).
+        // Таблица методов ссылается на элементы вектора, поэтому менять можно только
+        // содержимое методов, но не их количество
+        [[nodiscard]] std::vector<Method>& Methods();
+        [[nodiscard]] const std::vector<Method>& Methods() const;
+
+        // Возвращает пустую форму, с которой начинают все экземпляры класса
+        [[nodiscard]] const Shape& GetRootShape() const;
+
+        // Выводит в os строку "Class <имя класса>", например "Class cat"
+        void Print(std::ostream& os, Context& context) override;
+
+    private:
+        void BuildMethodTable();
+
+        std::string name_;
+        std::vector<Method> methods_;
+        const Class* parent_;
+        std::unordered_map<std::string, const Method*> method_table_;
+        std::array<const Method*, SPECIAL_METHOD_COUNT> special_methods_{};
+        // Форма хранится по указателю, чтобы перемещение класса не инвалидировало
+        // ссылки экземпляров на неё
+        std::unique_ptr<Shape> root_shape_ = std::make_unique<Shape>();
+    };
+
+    // Экземпляр класса
+    class ClassInstance : public Object {
+    public:
+        explicit ClassInstance(const Class& cls);
+        ClassInstance(const ClassInstance& other);
+        ClassInstance(ClassInstance&& other) noexcept;
+        ~ClassInstance() override;
+
+        // Создаёт в куче экземпляр класса cls без полей. Метод __init__ не вызывается.
+        // Перед созданием экземпляра может запустить сборку циклов (см. CycleCollector::MaybeCollect)
+        [[nodiscard]] static ObjectHolder Create(const Class& cls);
+
+        // Экземпляры размещаются в SlabPool::GetInstance()
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size) noexcept;
+
+        /*
+         * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
+         * В противном случае в os выводится адрес объекта.
+         */
+        void Print(std::ostream& os, Context& context) override;
+
+        /*
+         * Вызывает у объекта метод method, передавая ему actual_args параметров.
+         * Параметр context задаёт контекст для выполнения метода.
+         * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
+         * runtime_error
+         */
+        ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
+            Context& context);
+
+        // Вызывает у объекта метод method, найденный в его классе. Количество actual_args
+        // должно совпадать с количеством формальных параметров метода
+        ObjectHolder Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
+            Context& context);
+
+        // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
+        [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+
+        // Возвращает специальный метод класса объекта, принимающий argument_count параметров,
+        // либо nullptr, если такого метода нет
+        [[nodiscard]] const Method* GetSpecialMethod(SpecialMethod method, size_t argument_count) const;
+
+        // Возвращает указатель на значение поля name или nullptr, если у объекта нет такого поля
+        [[nodiscard]] ObjectHolder* FindField(const std::string& name);
+        [[nodiscard]] const ObjectHolder* FindField(const std::string& name) const;
+
+        // Присваивает полю name значение value. При первом присваивании поле добавляется
+        // и объект переходит в новую форму
+        ObjectHolder& SetField(const std::string& name, ObjectHolder value);
+
+        // Возвращает текущую форму объекта
+        [[nodiscard]] const Shape& GetShape() const;
+
+        // Возвращает значение поля с индексом index в форме объекта
+        [[nodiscard]] ObjectHolder& FieldAt(size_t index);
+        [[nodiscard]] const ObjectHolder& FieldAt(size_t index) const;
+
+        // Добавляет полю значение value и переводит объект в форму next, которая должна
+        // быть получена из текущей формы вызовом AddField
+        ObjectHolder& AddField(const Shape& next, ObjectHolder value);
+
+        // Возвращает класс, экземпляром которого является объект
+        [[nodiscard]] const Class& GetClass() const;
+
+    private:
+        friend class CycleCollector;
+
+        const Class& class_;
+        const Shape* shape_;
+        std::vector<ObjectHolder> fields_;
+        // Список всех экземпляров и рабочий счётчик сборщика циклов
+        ClassInstance* gc_prev_ = nullptr;
+        ClassInstance* gc_next_ = nullptr;
+        std::int64_t gc_refs_ = 0;
+    };
+
+    /*
+     * Кэш обращений к полю с фиксированным именем, размещаемый в месте обращения.
+     * Для нескольких последних форм запоминает индекс поля, а для присваивания нового поля -
+     * форму, в которую переходит объект. Обращение к объекту запомненной формы
+     * обходится без поиска поля по имени
+     */
+    class FieldCache {
+    public:
+        static constexpr size_t CAPACITY = 4;
+
+        // Возвращает указатель на значение поля name объекта instance или nullptr
+        const ObjectHolder* Get(const ClassInstance& instance, const std::string& name);
+
+        // Присваивает полю name объекта instance значение value
+        ObjectHolder& Set(ClassInstance& instance, const std::string& name, ObjectHolder value);
+
+        // Количество обращений, обслуженных кэшем, и обращений, потребовавших поиска в форме
+        [[nodiscard]] size_t GetHits() const;
+        [[nodiscard]] size_t GetMisses() const;
+
+    private:
+        struct Entry {
+            const Shape* shape = nullptr;
+            size_t index = Shape::NOT_FOUND;
+            // Форма после добавления поля, если в shape поля нет
+            const Shape* next = nullptr;
+        };
+
+        Entry Lookup(const Shape& shape, const std::string& name, bool adding);
+
+        std::array<Entry, CAPACITY> entries_;
+        size_t size_ = 0;
+        size_t hits_ = 0;
+        size_t misses_ = 0;
+    };
+
+    /*
+     * Возвращает true, если lhs и rhs содержат одинаковые числа, строки или значения типа Bool.
+     * Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs),
+     * приведённый к типу Bool. Если lhs и rhs имеют значение None, функция возвращает true.
+     * В остальных случаях функция выбрасывает исключение runtime_error.
+     *
+     * Параметр context задаёт контекст для выполнения метода __eq__
+     */
+    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    /*
+     * Если lhs и rhs - числа, строки или значения bool, функция возвращает результат их сравнения
+     * оператором <.
+     * Если lhs - объект с методом __lt__, возвращает результат вызова lhs.__lt__(rhs),
+     * приведённый к типу bool. В остальных случаях функция выбрасывает исключение runtime_error.
+     *
+     * Параметр context задаёт контекст для выполнения метода __lt__
+     */
+    bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    // Возвращает значение, противоположное Equal(lhs, rhs, context)
+    bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    // Возвращает значение lhs>rhs, используя функции Equal и Less
+    bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    // Возвращает значение lhs<=rhs, используя функции Equal и Less
+    bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    // Возвращает значение, противоположное Less(lhs, rhs, context)
+    bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    /*
+     * Возвращает результат операции + над lhs и rhs. Поддерживается сложение чисел, строк,
+     * а также объекта с методом __add__(rhs) с произвольным значением.
+     * В остальных случаях выбрасывает исключение runtime_error
+     */
+    ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    // Возвращают результат вычитания, умножения и деления чисел lhs и rhs.
+    // Если lhs и rhs - не числа либо делитель равен нулю, выбрасывается исключение runtime_error
+    ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs);
+    ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs);
+    ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs);
+
+    // Контекст-заглушка, применяется в тестах.
+    // В этом контексте весь вывод перенаправляется в строковый поток вывода output
+    struct DummyContext : Context {
+        std::ostream& GetOutputStream() override {
+            return output;
+        }
+
+        std::ostringstream output;
+    };
+
+    // Простой контекст, в нём вывод происходит в поток output, переданный в конструктор
+    class SimpleContext : public runtime::Context {
+    public:
+        explicit SimpleContext(std::ostream& output)
+            : output_(output) {
+        }
+
+        std::ostream& GetOutputStream() override {
+            return output_;
+        }
+
+    private:
+        std::ostream& output_;
+    };
+
+}  // namespace runtime
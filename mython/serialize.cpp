@@ -0,0 +1,610 @@
+#include "serialize.h"
+
+#include "arena.h"
+#include "lexer.h"
+#include "parse.h"
+#include "resolver.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+    namespace {
+
+        // Заголовок файла кэша. Меняется при любом изменении формата
+        constexpr string_view CACHE_MAGIC = "MYTHONC2"sv;
+        constexpr uint32_t NO_CLASS = UINT32_MAX;
+
+        enum class NodeTag : uint8_t {
+            NumericConst,
+            StringConst,
+            BoolConst,
+            None,
+            VariableValue,
+            Assignment,
+            FieldAssignment,
+            Print,
+            MethodCall,
+            NewInstance,
+            Stringify,
+            Add,
+            Sub,
+            Mult,
+            Div,
+            Or,
+            And,
+            Not,
+            Comparison,
+            Compound,
+            MethodBody,
+            Return,
+            ClassDefinition,
+            IfElse,
+        };
+
+        using ComparatorPtr = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+            runtime::Context&);
+
+        // Встроенные функции сравнения; в файле хранится индекс в этом массиве
+        const ComparatorPtr COMPARATORS[] = {
+            &runtime::Equal, &runtime::NotEqual, &runtime::Less,
+            &runtime::Greater, &runtime::LessOrEqual, &runtime::GreaterOrEqual,
+        };
+
+        class Writer {
+        public:
+            explicit Writer(ostream& out)
+                : out_(out) {
+            }
+
+            void WriteByte(uint8_t value) {
+                out_.put(static_cast<char>(value));
+            }
+
+            void WriteUint(uint64_t value, size_t size = sizeof(uint32_t)) {
+                for (size_t i = 0; i < size; ++i) {
+                    WriteByte(static_cast<uint8_t>(value >> (8 * i)));
+                }
+            }
+
+            void WriteString(string_view str) {
+                WriteUint(str.size());
+                WriteBytes(str);
+            }
+
+            void WriteBytes(string_view bytes) {
+                out_.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+            }
+
+        private:
+            ostream& out_;
+        };
+
+        // Читает данные, записанные Writer. Длины, прочитанные из данных, сверяются
+        // с количеством оставшихся байтов, поэтому повреждённый файл не приводит
+        // к выделению огромных блоков памяти
+        class Reader {
+        public:
+            explicit Reader(istream& in)
+                : in_(in)
+                , remaining_(CountRemaining(in)) {
+            }
+
+            uint8_t ReadByte() {
+                const auto c = in_.get();
+                if (c == istream::traits_type::eof()) {
+                    throw SerializeError("Unexpected end of serialized program"s);
+                }
+                --remaining_;
+                return static_cast<uint8_t>(c);
+            }
+
+            uint64_t ReadUint(size_t size = sizeof(uint32_t)) {
+                uint64_t value = 0;
+                for (size_t i = 0; i < size; ++i) {
+                    value |= uint64_t{ReadByte()} << (8 * i);
+                }
+                return value;
+            }
+
+            // Читает количество элементов, каждый из которых занимает в данных хотя бы один байт
+            uint64_t ReadLength() {
+                const uint64_t length = ReadUint();
+                if (length > remaining_) {
+                    throw SerializeError("Length exceeds serialized program size"s);
+                }
+                return length;
+            }
+
+            string ReadString() {
+                string result(ReadLength(), '\0');
+                if (!in_.read(result.data(), static_cast<streamsize>(result.size()))) {
+                    throw SerializeError("Unexpected end of serialized program"s);
+                }
+                remaining_ -= result.size();
+                return result;
+            }
+
+            // Читает expected.size() байтов и возвращает true, если они совпадают с expected
+            bool ReadAndCompare(string_view expected) {
+                if (expected.size() > remaining_) {
+                    return false;
+                }
+                array<char, 4096> chunk;
+                while (!expected.empty()) {
+                    const size_t size = min(chunk.size(), expected.size());
+                    if (!in_.read(chunk.data(), static_cast<streamsize>(size))) {
+                        throw SerializeError("Unexpected end of serialized program"s);
+                    }
+                    remaining_ -= size;
+                    if (expected.substr(0, size) != string_view(chunk.data(), size)) {
+                        return false;
+                    }
+                    expected.remove_prefix(size);
+                }
+                return true;
+            }
+
+        private:
+            // Количество байтов до конца потока. Если поток не поддерживает позиционирование,
+            // длины ограничивает только конец данных
+            static uint64_t CountRemaining(istream& in) {
+                const auto start = in.tellg();
+                if (start == istream::pos_type(-1) || !in.seekg(0, ios::end)) {
+                    in.clear();
+                    return numeric_limits<uint64_t>::max();
+                }
+                const auto end = in.tellg();
+                in.seekg(start);
+                return static_cast<uint64_t>(end - start);
+            }
+
+            istream& in_;
+            uint64_t remaining_;
+        };
+
+        class ProgramWriter {
+        public:
+            explicit ProgramWriter(ostream& out)
+                : writer_(out) {
+            }
+
+            void Write(const Statement& stmt) {
+                if (const auto* num = dynamic_cast<const NumericConst*>(&stmt)) {
+                    Tag(NodeTag::NumericConst);
+                    writer_.WriteUint(static_cast<uint32_t>(num->GetValue().GetValue()));
+                }
+                else if (const auto* str = dynamic_cast<const StringConst*>(&stmt)) {
+                    Tag(NodeTag::StringConst);
+                    writer_.WriteString(str->GetValue().GetValue());
+                }
+                else if (const auto* boolean = dynamic_cast<const BoolConst*>(&stmt)) {
+                    Tag(NodeTag::BoolConst);
+                    writer_.WriteByte(boolean->GetValue().GetValue() ? 1 : 0);
+                }
+                else if (dynamic_cast<const None*>(&stmt)) {
+                    Tag(NodeTag::None);
+                }
+                else if (const auto* value = dynamic_cast<const VariableValue*>(&stmt)) {
+                    Tag(NodeTag::VariableValue);
+                    WriteDottedIds(*value);
+                }
+                else if (const auto* assignment = dynamic_cast<const Assignment*>(&stmt)) {
+                    Tag(NodeTag::Assignment);
+                    writer_.WriteString(assignment->GetVarName());
+                    Write(assignment->GetRightValue());
+                }
+                else if (const auto* field_assignment = dynamic_cast<const FieldAssignment*>(&stmt)) {
+                    Tag(NodeTag::FieldAssignment);
+                    WriteDottedIds(field_assignment->GetObject());
+                    writer_.WriteString(field_assignment->GetFieldName());
+                    Write(field_assignment->GetRightValue());
+                }
+                else if (const auto* print = dynamic_cast<const Print*>(&stmt)) {
+                    Tag(NodeTag::Print);
+                    WriteAll(print->GetArgs());
+                }
+                else if (const auto* call = dynamic_cast<const MethodCall*>(&stmt)) {
+                    Tag(NodeTag::MethodCall);
+                    Write(call->GetObject());
+                    writer_.WriteString(call->GetMethodName());
+                    WriteAll(call->GetArgs());
+                }
+                else if (const auto* instance = dynamic_cast<const NewInstance*>(&stmt)) {
+                    Tag(NodeTag::NewInstance);
+                    writer_.WriteUint(GetClassId(&instance->GetClass()));
+                    WriteAll(instance->GetArgs());
+                }
+                else if (const auto* stringify = dynamic_cast<const Stringify*>(&stmt)) {
+                    Tag(NodeTag::Stringify);
+                    Write(stringify->GetArgument());
+                }
+                else if (const auto* negation = dynamic_cast<const Not*>(&stmt)) {
+                    Tag(NodeTag::Not);
+                    Write(negation->GetArgument());
+                }
+                else if (const auto* comparison = dynamic_cast<const Comparison*>(&stmt)) {
+                    Tag(NodeTag::Comparison);
+                    writer_.WriteByte(GetComparatorId(comparison->GetComparator()));
+                    Write(comparison->GetLhs());
+                    Write(comparison->GetRhs());
+                }
+                else if (const auto* binary = dynamic_cast<const BinaryOperation*>(&stmt)) {
+                    Tag(GetBinaryTag(*binary));
+                    Write(binary->GetLhs());
+                    Write(binary->GetRhs());
+                }
+                else if (const auto* compound = dynamic_cast<const Compound*>(&stmt)) {
+                    Tag(NodeTag::Compound);
+                    WriteAll(compound->GetStatements());
+                }
+                else if (const auto* body = dynamic_cast<const MethodBody*>(&stmt)) {
+                    Tag(NodeTag::MethodBody);
+                    Write(body->GetBody());
+                }
+                else if (const auto* ret = dynamic_cast<const Return*>(&stmt)) {
+                    Tag(NodeTag::Return);
+                    Write(ret->GetStatement());
+                }
+                else if (const auto* definition = dynamic_cast<const ClassDefinition*>(&stmt)) {
+                    Tag(NodeTag::ClassDefinition);
+                    WriteClass(*definition->GetClass().TryAs<runtime::Class>());
+                }
+                else if (const auto* if_else = dynamic_cast<const IfElse*>(&stmt)) {
+                    Tag(NodeTag::IfElse);
+                    Write(if_else->GetCondition());
+                    Write(if_else->GetIfBody());
+                    const Statement* else_body = if_else->GetElseBody();
+                    writer_.WriteByte(else_body ? 1 : 0);
+                    if (else_body) {
+                        Write(*else_body);
+                    }
+                }
+                else {
+                    throw SerializeError("Unsupported statement"s);
+                }
+            }
+
+        private:
+            void Tag(NodeTag tag) {
+                writer_.WriteByte(static_cast<uint8_t>(tag));
+            }
+
+            void WriteAll(const vector<unique_ptr<Statement>>& statements) {
+                writer_.WriteUint(statements.size());
+                for (const auto& stmt : statements) {
+                    Write(*stmt);
+                }
+            }
+
+            void WriteDottedIds(const VariableValue& value) {
+                const auto& ids = value.GetDottedIds();
+                writer_.WriteUint(ids.size());
+                for (const auto& id : ids) {
+                    writer_.WriteString(id);
+                }
+            }
+
+            // Класс записывается вместе с телами методов на месте своего объявления.
+            // Родитель и классы, экземпляры которых создаются в программе, объявлены раньше
+            void WriteClass(const runtime::Class& cls) {
+                writer_.WriteString(cls.GetName());
+                writer_.WriteUint(cls.GetParent() ? GetClassId(cls.GetParent()) : NO_CLASS);
+                writer_.WriteUint(cls.Methods().size());
+                for (const auto& method : cls.Methods()) {
+                    writer_.WriteString(method.name);
+                    writer_.WriteUint(method.formal_params.size());
+                    for (const auto& param : method.formal_params) {
+                        writer_.WriteString(param);
+                    }
+                    Write(*method.body);
+                }
+                class_ids_.emplace(&cls, static_cast<uint32_t>(class_ids_.size()));
+            }
+
+            uint32_t GetClassId(const runtime::Class* cls) const {
+                const auto it = class_ids_.find(cls);
+                if (it == class_ids_.end()) {
+                    throw SerializeError("Class "s + cls->GetName() + " is not declared before use"s);
+                }
+                return it->second;
+            }
+
+            static uint8_t GetComparatorId(const Comparison::Comparator& comparator) {
+                if (const auto* ptr = comparator.target<ComparatorPtr>()) {
+                    for (size_t i = 0; i < size(COMPARATORS); ++i) {
+                        if (*ptr == COMPARATORS[i]) {
+                            return static_cast<uint8_t>(i);
+                        }
+                    }
+                }
+                throw SerializeError("User-defined comparators cannot be serialized"s);
+            }
+
+            static NodeTag GetBinaryTag(const BinaryOperation& binary) {
+                if (dynamic_cast<const Add*>(&binary)) {
+                    return NodeTag::Add;
+                }
+                if (dynamic_cast<const Sub*>(&binary)) {
+                    return NodeTag::Sub;
+                }
+                if (dynamic_cast<const Mult*>(&binary)) {
+                    return NodeTag::Mult;
+                }
+                if (dynamic_cast<const Div*>(&binary)) {
+                    return NodeTag::Div;
+                }
+                if (dynamic_cast<const Or*>(&binary)) {
+                    return NodeTag::Or;
+                }
+                if (dynamic_cast<const And*>(&binary)) {
+                    return NodeTag::And;
+                }
+                throw SerializeError("Unsupported binary operation"s);
+            }
+
+            Writer writer_;
+            unordered_map<const runtime::Class*, uint32_t> class_ids_;
+        };
+
+        class ProgramReader {
+        public:
+            explicit ProgramReader(istream& in)
+                : reader_(in) {
+            }
+
+            unique_ptr<Statement> Read() {
+                const auto tag = static_cast<NodeTag>(reader_.ReadByte());
+                switch (tag) {
+                case NodeTag::NumericConst:
+                    return make_unique<NumericConst>(static_cast<int>(static_cast<uint32_t>(reader_.ReadUint())));
+                case NodeTag::StringConst:
+                    return make_unique<StringConst>(reader_.ReadString());
+                case NodeTag::BoolConst:
+                    return make_unique<BoolConst>(runtime::Bool(reader_.ReadByte() != 0));
+                case NodeTag::None:
+                    return make_unique<None>();
+                case NodeTag::VariableValue:
+                    return make_unique<VariableValue>(ReadDottedIds());
+                case NodeTag::Assignment: {
+                    string name = reader_.ReadString();
+                    return make_unique<Assignment>(std::move(name), Read());
+                }
+                case NodeTag::FieldAssignment: {
+                    VariableValue object(ReadDottedIds());
+                    string field_name = reader_.ReadString();
+                    return make_unique<FieldAssignment>(std::move(object), std::move(field_name), Read());
+                }
+                case NodeTag::Print:
+                    return make_unique<Print>(ReadAll());
+                case NodeTag::MethodCall: {
+                    auto object = Read();
+                    string method = reader_.ReadString();
+                    return make_unique<MethodCall>(std::move(object), std::move(method), ReadAll());
+                }
+                case NodeTag::NewInstance: {
+                    const runtime::Class& cls = GetClass(static_cast<uint32_t>(reader_.ReadUint()));
+                    return make_unique<NewInstance>(cls, ReadAll());
+                }
+                case NodeTag::Stringify:
+                    return make_unique<Stringify>(Read());
+                case NodeTag::Not:
+                    return make_unique<Not>(Read());
+                case NodeTag::Comparison: {
+                    const uint8_t id = reader_.ReadByte();
+                    if (id >= size(COMPARATORS)) {
+                        throw SerializeError("Unknown comparator"s);
+                    }
+                    auto lhs = Read();
+                    return make_unique<Comparison>(COMPARATORS[id], std::move(lhs), Read());
+                }
+                case NodeTag::Add:
+                    return ReadBinary<Add>();
+                case NodeTag::Sub:
+                    return ReadBinary<Sub>();
+                case NodeTag::Mult:
+                    return ReadBinary<Mult>();
+                case NodeTag::Div:
+                    return ReadBinary<Div>();
+                case NodeTag::Or:
+                    return ReadBinary<Or>();
+                case NodeTag::And:
+                    return ReadBinary<And>();
+                case NodeTag::Compound: {
+                    auto compound = make_unique<Compound>();
+                    for (auto& stmt : ReadAll()) {
+                        compound->AddStatement(std::move(stmt));
+                    }
+                    return compound;
+                }
+                case NodeTag::MethodBody:
+                    return make_unique<MethodBody>(Read());
+                case NodeTag::Return:
+                    return make_unique<Return>(Read());
+                case NodeTag::ClassDefinition:
+                    return make_unique<ClassDefinition>(ReadClass());
+                case NodeTag::IfElse: {
+                    auto condition = Read();
+                    auto if_body = Read();
+                    unique_ptr<Statement> else_body;
+                    if (reader_.ReadByte() != 0) {
+                        else_body = Read();
+                    }
+                    return make_unique<IfElse>(std::move(condition), std::move(if_body), std::move(else_body));
+                }
+                }
+                throw SerializeError("Unknown statement tag"s);
+            }
+
+        private:
+            template <typename Operation>
+            unique_ptr<Statement> ReadBinary() {
+                auto lhs = Read();
+                return make_unique<Operation>(std::move(lhs), Read());
+            }
+
+            vector<unique_ptr<Statement>> ReadAll() {
+                const auto count = reader_.ReadLength();
+                vector<unique_ptr<Statement>> result;
+                for (uint64_t i = 0; i < count; ++i) {
+                    result.push_back(Read());
+                }
+                return result;
+            }
+
+            vector<string> ReadDottedIds() {
+                const auto count = reader_.ReadLength();
+                vector<string> result;
+                for (uint64_t i = 0; i < count; ++i) {
+                    result.push_back(reader_.ReadString());
+                }
+                return result;
+            }
+
+            runtime::ObjectHolder ReadClass() {
+                string name = reader_.ReadString();
+                const auto parent_id = static_cast<uint32_t>(reader_.ReadUint());
+                const runtime::Class* parent = parent_id == NO_CLASS ? nullptr : &GetClass(parent_id);
+
+                vector<runtime::Method> methods(reader_.ReadLength());
+                for (auto& method : methods) {
+                    method.name = reader_.ReadString();
+                    method.formal_params.resize(reader_.ReadLength());
+                    for (auto& param : method.formal_params) {
+                        param = reader_.ReadString();
+                    }
+                    method.body = Read();
+                }
+                classes_.push_back(
+                    runtime::ObjectHolder::Own(runtime::Class(std::move(name), std::move(methods), parent)));
+                return classes_.back();
+            }
+
+            const runtime::Class& GetClass(uint32_t id) const {
+                if (id >= classes_.size()) {
+                    throw SerializeError("Unknown class"s);
+                }
+                return *classes_[id].TryAs<runtime::Class>();
+            }
+
+            Reader reader_;
+            vector<runtime::ObjectHolder> classes_;
+        };
+
+    }  // namespace
+
+    void SaveProgram(const Statement& program, ostream& out) {
+        ProgramWriter{out}.Write(program);
+    }
+
+    unique_ptr<Statement> LoadProgram(istream& in) {
+        unique_ptr<Statement> program;
+        {
+            runtime::Arena::Scope arena_scope;
+            program = ProgramReader{in}.Read();
+        }
+        ResolveSlots(*program);
+        return program;
+    }
+
+    ProgramCache::ProgramCache(filesystem::path directory)
+        : directory_(std::move(directory)) {
+    }
+
+    unique_ptr<Statement> ProgramCache::Load(string_view source) {
+        const uint64_t hash = HashSource(source);
+        const auto path = GetPath(hash);
+
+        if (ifstream in{path, ios::binary}) {
+            try {
+                Reader reader(in);
+                string magic(CACHE_MAGIC.size(), '\0');
+                for (char& c : magic) {
+                    c = static_cast<char>(reader.ReadByte());
+                }
+                // Хеш лишь выбирает имя файла и может совпасть у разных текстов, поэтому
+                // файл принадлежит программе, только если в нём записан тот же текст
+                if (magic == CACHE_MAGIC && reader.ReadUint(sizeof(uint64_t)) == source.size()
+                    && reader.ReadAndCompare(source)) {
+                    auto program = LoadProgram(in);
+                    ++hits_;
+                    return program;
+                }
+            }
+            // Повреждённый файл кэша перезаписывается заново разобранной программой
+            catch (const SerializeError&) {
+            }
+            catch (const bad_alloc&) {
+            }
+            catch (const length_error&) {
+            }
+        }
+
+        ++misses_;
+        parse::Lexer lexer(source);
+        auto program = ParseProgram(lexer);
+
+        // Файл пишется под временным именем и переименовывается, чтобы параллельно
+        // запущенные интерпретаторы не прочитали его частично записанным
+        error_code ec;
+        filesystem::create_directories(directory_, ec);
+        auto temp_path = path;
+        temp_path += "."s + to_string(random_device{}()) + ".tmp"s;
+        try {
+            {
+                ofstream out(temp_path, ios::binary);
+                Writer writer(out);
+                for (char c : CACHE_MAGIC) {
+                    writer.WriteByte(static_cast<uint8_t>(c));
+                }
+                writer.WriteUint(source.size(), sizeof(uint64_t));
+                writer.WriteBytes(source);
+                SaveProgram(*program, out);
+                if (!out) {
+                    throw SerializeError("Failed to write program cache"s);
+                }
+            }
+            filesystem::rename(temp_path, path, ec);
+        }
+        catch (const SerializeError&) {
+            // Программа исполняется и без кэша
+        }
+        filesystem::remove(temp_path, ec);
+        return program;
+    }
+
+    filesystem::path ProgramCache::GetPath(string_view source) const {
+        return GetPath(HashSource(source));
+    }
+
+    filesystem::path ProgramCache::GetPath(uint64_t hash) const {
+        static constexpr char DIGITS[] = "0123456789abcdef";
+        string name(16, '0');
+        for (auto it = name.rbegin(); it != name.rend(); ++it, hash >>= 4) {
+            *it = DIGITS[hash & 0xF];
+        }
+        return directory_ / (name + ".myc"s);
+    }
+
+    uint64_t ProgramCache::HashSource(string_view source) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char c : source) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+}  // namespace ast
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "statement.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+
+namespace ast {
+
+    class SerializeError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /*
+     * Записывает в out дерево программы, построенное ParseProgram, вместе с объявленными
+     * в ней классами и телами их методов. Слоты кадров не сохраняются - LoadProgram
+     * назначает их заново. Если дерево содержит узлы, которые нельзя сохранить
+     * (например, экземпляр класса, не объявленного в программе, или тело метода, разбор
+     * которого отложен до вызова), выбрасывается SerializeError
+     */
+    void SaveProgram(const Statement& program, std::ostream& out);
+
+    // Восстанавливает дерево программы, записанное SaveProgram. При повреждённых
+    // или неполных данных выбрасывает SerializeError
+    std::unique_ptr<Statement> LoadProgram(std::istream& in);
+
+    /*
+     * Кэш разобранных программ в каталоге directory. Файл кэша называется по хешу текста
+     * программы и хранит сам текст: файл используется, только если текст в нём совпадает
+     * с загружаемым. Поэтому изменённый текст разбирается заново, а неизменённый загружается
+     * без лексического и синтаксического анализа
+     */
+    class ProgramCache {
+    public:
+        explicit ProgramCache(std::filesystem::path directory);
+
+        // Возвращает дерево программы с текстом source: из кэша, если он там есть,
+        // иначе разбирает текст с помощью ParseProgram и сохраняет результат в кэш
+        std::unique_ptr<Statement> Load(std::string_view source);
+
+        // Путь к файлу кэша для программы с текстом source
+        [[nodiscard]] std::filesystem::path GetPath(std::string_view source) const;
+
+        [[nodiscard]] size_t GetHits() const {
+            return hits_;
+        }
+
+        [[nodiscard]] size_t GetMisses() const {
+            return misses_;
+        }
+
+        // 64-битный хеш FNV-1a текста программы
+        static std::uint64_t HashSource(std::string_view source);
+
+    private:
+        [[nodiscard]] std::filesystem::path GetPath(std::uint64_t hash) const;
+
+        std::filesystem::path directory_;
+        size_t hits_ = 0;
+        size_t misses_ = 0;
+    };
+
+}  // namespace ast
@@ -0,0 +1,46 @@
+#include "slab.h"
+
+#include <new>
+
+using namespace std;
+
+namespace runtime {
+
+    SlabPool& SlabPool::GetInstance() {
+        // Пул не уничтожается, чтобы объекты в статических переменных можно было
+        // освобождать и после выхода из main
+        static SlabPool* pool = new SlabPool();
+        return *pool;
+    }
+
+    void* SlabPool::Allocate(size_t size) {
+        if (size > MAX_SIZE) {
+            return ::operator new(size);
+        }
+        ++live_count_;
+        const size_t size_class = size == 0 ? 0 : (size - 1) / GRANULARITY;
+        if (FreeBlock* block = free_lists_[size_class]) {
+            free_lists_[size_class] = block->next;
+            return block;
+        }
+        const size_t block_size = (size_class + 1) * GRANULARITY;
+        if (used_ + block_size > SLAB_SIZE) {
+            slabs_.emplace_back(new byte[SLAB_SIZE]);
+            used_ = 0;
+        }
+        void* result = slabs_.back().get() + used_;
+        used_ += block_size;
+        return result;
+    }
+
+    void SlabPool::Deallocate(void* ptr, size_t size) noexcept {
+        if (size > MAX_SIZE) {
+            ::operator delete(ptr);
+            return;
+        }
+        --live_count_;
+        const size_t size_class = size == 0 ? 0 : (size - 1) / GRANULARITY;
+        free_lists_[size_class] = new (ptr) FreeBlock{ free_lists_[size_class] };
+    }
+
+}  // namespace runtime
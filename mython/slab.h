@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace runtime {
+
+    /*
+     * Пул блоков для объектов, которые программа создаёт и уничтожает в больших количествах.
+     * Размер запроса округляется вверх до класса размера, кратного GRANULARITY. Освобождённый
+     * блок попадает в список свободных блоков своего класса и выдаётся повторно, не обращаясь
+     * к глобальному malloc. Память пул получает слэбами по SLAB_SIZE байт и возвращает её только
+     * при своём уничтожении. Запросы больше MAX_SIZE байт обслуживает operator new.
+     * Пул не потокобезопасен
+     */
+    class SlabPool {
+    public:
+        static constexpr size_t GRANULARITY = alignof(std::max_align_t);
+        static constexpr size_t MAX_SIZE = 256;
+        static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+        SlabPool() = default;
+        SlabPool(const SlabPool&) = delete;
+        SlabPool& operator=(const SlabPool&) = delete;
+
+        // Возвращает пул, из которого размещаются экземпляры классов. Пул существует
+        // до завершения программы
+        [[nodiscard]] static SlabPool& GetInstance();
+
+        // Выделяет size байт, выровненных по GRANULARITY
+        void* Allocate(size_t size);
+
+        // Освобождает блок ptr, выделенный вызовом Allocate(size)
+        void Deallocate(void* ptr, size_t size) noexcept;
+
+        // Количество выделенных слэбов
+        [[nodiscard]] size_t GetSlabCount() const {
+            return slabs_.size();
+        }
+
+        // Количество выданных и ещё не освобождённых блоков
+        [[nodiscard]] size_t GetLiveCount() const {
+            return live_count_;
+        }
+
+    private:
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        static constexpr size_t CLASS_COUNT = MAX_SIZE / GRANULARITY;
+
+        std::array<FreeBlock*, CLASS_COUNT> free_lists_{};
+        std::vector<std::unique_ptr<std::byte[]>> slabs_;
+        size_t used_ = SLAB_SIZE;
+        size_t live_count_ = 0;
+    };
+
+}  // namespace runtime
@@ -1,313 +1,609 @@
-#include "statement.h"
-
-#include <iostream>
-#include <sstream>
-#include <utility>
-
-using namespace std;
-
-namespace ast {
-
-    using runtime::Closure;
-    using runtime::Context;
-    using runtime::ObjectHolder;
-
-    namespace {
-        const string ADD_METHOD = "__add__"s;
-        const string INIT_METHOD = "__init__"s;
-    }  // namespace
-
-    ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
-        closure[var_] = rv_->Execute(closure, context);
-        return closure[var_];
-    }
-
-    Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv) 
-        : var_(std::move(var))
-        , rv_(std::move(rv)) {}
-
-    VariableValue::VariableValue(const std::string& var_name) {
-        dotted_ids_.push_back(var_name);
-    }
-
-    VariableValue::VariableValue(std::vector<std::string> dotted_ids)
-        : dotted_ids_(std::move(dotted_ids)) {}
-    
-
-    ObjectHolder VariableValue::Execute(Closure& closure, [[maybe_unused]] Context& context) {
-        Closure* closure_ptr = &closure;
-        for (size_t i = 0; i < dotted_ids_.size(); ++i) {
-            const std::string& field_name = dotted_ids_[i];
-            if (closure_ptr->count(field_name) == 0) {
-                throw std::runtime_error("Cant find var"s);
-            }
-            if (i == dotted_ids_.size() - 1) {
-                return closure_ptr->at(field_name);
-            }
-            auto ptr_obj = closure_ptr->at(field_name).TryAs<runtime::ClassInstance>();
-            if (!ptr_obj) {
-                throw std::runtime_error("This isn't object"s);
-            }
-            closure_ptr = &ptr_obj->Fields();
-        }
-        return {};
-    }
-
-    unique_ptr<Print> Print::Variable(const std::string& name) {
-        return std::make_unique<Print>(std::make_unique<VariableValue>(name));
-    }
-
-    Print::Print(unique_ptr<Statement> argument) {
-        args_.push_back(std::move(argument));
-    }
-
-    Print::Print(vector<unique_ptr<Statement>> args) 
-        : args_(std::move(args)){}
-
-    ObjectHolder Print::Execute(Closure& closure, Context& context) {
-        ObjectHolder obj;
-        bool first_arg = true;
-        for (const auto& arg : args_) {
-            if (!first_arg) {
-                context.GetOutputStream() << " "s;
-            }
-            first_arg = false;
-            obj = arg->Execute(closure, context);
-            if (obj) {
-                obj->Print(context.GetOutputStream(), context);
-            }
-            else {
-                context.GetOutputStream() << "None"s;
-            }
-        }
-        context.GetOutputStream() << "\n"s;
-        return {};
-    }
-
-    MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
-        std::vector<std::unique_ptr<Statement>> args) 
-        : object_(std::move(object))
-        , method_(std::move(method))
-        , args_(std::move(args)) {}
-
-    ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
-        const auto obj = object_->Execute(closure, context);
-        const auto class_instance_ptr = obj.TryAs<runtime::ClassInstance>();
-        if (obj && class_instance_ptr && class_instance_ptr->HasMethod(method_, args_.size())) {
-            std::vector<runtime::ObjectHolder> actual_args;
-            for (const auto& arg : args_) {
-                actual_args.push_back(arg->Execute(closure, context));
-            }
-            return class_instance_ptr->Call(method_, actual_args, context);
-        }
-        return {};
-    }
-
-    ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
-        auto obj = argument_->Execute(closure, context);
-        if (!obj) {
-            return ObjectHolder::Own(runtime::String{ "None"s });
-        }
-        runtime::DummyContext dummy_context;
-        obj->Print(dummy_context.output, dummy_context);
-        return ObjectHolder::Own(runtime::String{ dummy_context.output.str() });
-    }
-
-    ObjectHolder Add::Execute(Closure& closure, Context& context) {
-        auto lhs = lhs_->Execute(closure, context);
-        auto rhs = rhs_->Execute(closure, context);
-
-        auto lhs_number = lhs.TryAs<runtime::Number>();
-        auto rhs_number = rhs.TryAs<runtime::Number>();
-        if (lhs_number != nullptr && rhs_number != nullptr) {
-            int number = lhs_number->GetValue() + rhs_number->GetValue();
-            return runtime::ObjectHolder::Own(runtime::Number{ number });
-        }
-
-        auto lhs_string = lhs.TryAs<runtime::String>();
-        auto rhs_string = rhs.TryAs<runtime::String>();
-        if (lhs_string != nullptr && rhs_string != nullptr) {
-            string str = lhs_string->GetValue() + rhs_string->GetValue();
-            return runtime::ObjectHolder::Own(runtime::String{ std::move(str) });
-        }
-
-        auto lhs_instance = lhs.TryAs<runtime::ClassInstance>();
-        if (lhs_instance != nullptr && lhs_instance->HasMethod(ADD_METHOD, 1)) {
-            std::vector<ObjectHolder> actual_args = { rhs };
-            return lhs_instance->Call(ADD_METHOD, actual_args, context);
-        }
-
-        throw std::runtime_error("No __add__ method"s);
-    }
-
-    ObjectHolder Sub::Execute(Closure& closure, Context& context) {
-        auto lhs = lhs_->Execute(closure, context);
-        auto rhs = rhs_->Execute(closure, context);
-
-        auto lhs_number = lhs.TryAs<runtime::Number>();
-        auto rhs_number = rhs.TryAs<runtime::Number>();
-        if (lhs_number != nullptr && rhs_number != nullptr) {
-            int number = lhs_number->GetValue() - rhs_number->GetValue();
-            return runtime::ObjectHolder::Own(runtime::Number{ number });
-        }
-
-        throw std::runtime_error("lhs or rhs not Number"s);
-    }
-
-    ObjectHolder Mult::Execute(Closure& closure, Context& context) {
-        auto lhs = lhs_->Execute(closure, context);
-        auto rhs = rhs_->Execute(closure, context);
-
-        auto lhs_number = lhs.TryAs<runtime::Number>();
-        auto rhs_number = rhs.TryAs<runtime::Number>();
-        if (lhs_number != nullptr && rhs_number != nullptr) {
-            int number = lhs_number->GetValue() * rhs_number->GetValue();
-            return runtime::ObjectHolder::Own(runtime::Number{ number });
-        }
-
-        throw std::runtime_error("lhs or rhs not Number"s);
-    }
-
-    ObjectHolder Div::Execute(Closure& closure, Context& context) {
-        auto lhs = lhs_->Execute(closure, context);
-        auto rhs = rhs_->Execute(closure, context);
-
-        auto lhs_number = lhs.TryAs<runtime::Number>();
-        auto rhs_number = rhs.TryAs<runtime::Number>();
-        if (lhs_number != nullptr && rhs_number != nullptr) {
-            if (rhs_number->GetValue() == 0) {
-                throw std::runtime_error("Division by zero"s);
-            }
-
-            int number = lhs_number->GetValue() / rhs_number->GetValue();
-            return runtime::ObjectHolder::Own(runtime::Number{ number });
-        }
-
-        throw std::runtime_error("lhs or rhs not Number"s);
-    }
-
-    void Compound::AddStatement(std::unique_ptr<Statement> stmt)
-    {
-        stmt_.push_back(std::move(stmt));
-    }
-
-    ObjectHolder Compound::Execute(Closure& closure, [[maybe_unused]] Context& context) {
-        for (const auto& statement : stmt_) {
-            statement->Execute(closure, context);
-        }
-        return {};
-    }
-
-    
-    Return::Return(std::unique_ptr<Statement> statement)
-        : statement_(std::move(statement)) {}
-
-    ObjectHolder Return::Execute(Closure& closure, Context& context) {
-        throw statement_->Execute(closure, context);
-    }
-
-    ClassDefinition::ClassDefinition(ObjectHolder cls) 
-        : cls_(cls){}
-
-    ObjectHolder ClassDefinition::Execute(Closure& closure, [[maybe_unused]] Context& context) {
-        const auto obj = cls_.TryAs<runtime::Class>();
-        closure[obj->GetName()] = std::move(cls_);
-        return {};
-    }
-
-    FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
-        std::unique_ptr<Statement> rv)
-        : object_(std::move(object))
-        , field_name_(std::move(field_name))
-        , rv_(std::move(rv)) {}
-
-    ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
-        const auto obj = object_.Execute(closure, context);
-        const auto class_inst_ptr = obj.TryAs<runtime::ClassInstance>();
-        if (class_inst_ptr) {
-            class_inst_ptr->Fields()[field_name_] = rv_->Execute(closure, context);
-            return class_inst_ptr->Fields()[field_name_];
-        }
-        throw std::runtime_error("Cant find field"s);
-    }
-
-    IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
-        std::unique_ptr<Statement> else_body) 
-        : condition_(std::move(condition))
-        , if_body_(std::move(if_body))
-        , else_body_(std::move(else_body)){}
-
-    ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
-        if (runtime::IsTrue(condition_->Execute(closure, context))) {
-            return if_body_->Execute(closure, context);
-        }
-        else if (else_body_ != nullptr) {
-            return else_body_->Execute(closure, context);
-        }
-        else {
-            return ObjectHolder::None();
-        }
-    }
-
-    ObjectHolder Or::Execute(Closure& closure, Context& context) {
-        auto lhs = lhs_->Execute(closure, context);
-        auto rhs = rhs_->Execute(closure, context);
-        bool result = (runtime::IsTrue(lhs) || runtime::IsTrue(rhs));
-        return runtime::ObjectHolder::Own(runtime::Bool{ result });
-    }
-
-    ObjectHolder And::Execute(Closure& closure, Context& context) {
-        auto lhs = lhs_->Execute(closure, context);
-        auto rhs = rhs_->Execute(closure, context);
-        bool result = (runtime::IsTrue(lhs) && runtime::IsTrue(rhs));
-        return runtime::ObjectHolder::Own(runtime::Bool{ result });
-    }
-
-    ObjectHolder Not::Execute(Closure& closure, Context& context) {
-        auto arg = argument_->Execute(closure, context);
-        bool result = !runtime::IsTrue(arg);
-        return runtime::ObjectHolder::Own(runtime::Bool{ result });
-    }
-
-    Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
-        : BinaryOperation(std::move(lhs), std::move(rhs))
-        , cmp_(std::move(cmp)){}
-
-    ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
-        auto lhs = lhs_->Execute(closure, context);
-        auto rhs = rhs_->Execute(closure, context);
-        bool result = cmp_(lhs, rhs, context);
-        return runtime::ObjectHolder::Own(runtime::Bool{ result });
-    }
-
-    NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args) 
-        : cls_(class_)
-        , args_(std::move(args)){}
-
-    NewInstance::NewInstance(const runtime::Class& class_) 
-        : cls_(class_){}
-
-    ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
-        std::vector<runtime::ObjectHolder> actual_args;
-        for (const auto& arg : args_) {
-            actual_args.push_back(arg->Execute(closure, context));
-        }
-        if (cls_.HasMethod(INIT_METHOD, args_.size())) {
-            cls_.Call(INIT_METHOD, actual_args, context);
-        }
-        return ObjectHolder::Share(cls_);
-    }
-
-    MethodBody::MethodBody(std::unique_ptr<Statement>&& body) : body_(std::move(body)){}
-
-    ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
-        try {
-            body_->Execute(closure, context);
-            return runtime::ObjectHolder::None();
-        }
-        catch (runtime::ObjectHolder& obj) {
-            return obj;
-        }
-    }
-
-}  // namespace ast
+#include "statement.h"
+
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+using namespace std;
+
+namespace ast {
+
+    using runtime::Closure;
+    using runtime::Context;
+    using runtime::ObjectHolder;
+
+    namespace {
+        // Возвращает value, а если это заимствованный экземпляр класса - его копию в temp.
+        // Методы экземпляра могут изменить хранилище заимствованной ссылки, в том числе
+        // удалить последнюю ссылку на сам экземпляр
+        const ObjectHolder& Pin(const ObjectHolder& value, ObjectHolder& temp) {
+            if (&value != &temp && value.GetKind() == runtime::ObjectKind::ClassInstance) {
+                temp = value;
+                return temp;
+            }
+            return value;
+        }
+    }  // namespace
+
+    ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
+        if (slot_) {
+            auto value = rv_->Execute(closure, context);
+            auto& slot = context.GetFrames()[*slot_];
+            slot = std::move(value);
+            return slot;
+        }
+        closure[var_] = rv_->Execute(closure, context);
+        return closure[var_];
+    }
+
+    Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv) 
+        : var_(std::move(var))
+        , rv_(std::move(rv)) {}
+
+    const std::string& Assignment::GetVarName() const {
+        return var_;
+    }
+
+    const Statement& Assignment::GetRightValue() const {
+        return *rv_;
+    }
+
+    unique_ptr<Statement>& Assignment::RightValue() {
+        return rv_;
+    }
+
+    void Assignment::SetSlot(size_t slot) {
+        slot_ = slot;
+    }
+
+    optional<size_t> Assignment::GetSlot() const {
+        return slot_;
+    }
+
+    VariableValue::VariableValue(const std::string& var_name) {
+        dotted_ids_.push_back(var_name);
+    }
+
+    VariableValue::VariableValue(std::vector<std::string> dotted_ids)
+        : dotted_ids_(std::move(dotted_ids))
+        , field_caches_(dotted_ids_.empty() ? 0 : dotted_ids_.size() - 1) {}
+    
+
+    ObjectHolder VariableValue::Execute(Closure& closure, Context& context) {
+        ObjectHolder temp;
+        return Borrow(closure, context, temp);
+    }
+
+    const ObjectHolder& VariableValue::Borrow(Closure& closure, Context& context,
+        [[maybe_unused]] ObjectHolder& temp) {
+        const ObjectHolder* value = nullptr;
+        if (slot_) {
+            value = &context.GetFrames()[*slot_];
+            if (runtime::FrameStack::IsUnbound(*value)) {
+                throw std::runtime_error("Cant find var"s);
+            }
+        }
+        else {
+            const auto it = closure.find(dotted_ids_.front());
+            if (it == closure.end()) {
+                throw std::runtime_error("Cant find var"s);
+            }
+            value = &it->second;
+        }
+        for (size_t i = 1; i < dotted_ids_.size(); ++i) {
+            auto ptr_obj = value->TryAs<runtime::ClassInstance>();
+            if (!ptr_obj) {
+                throw std::runtime_error("This isn't object"s);
+            }
+            value = field_caches_[i - 1].Get(*ptr_obj, dotted_ids_[i]);
+            if (!value) {
+                throw std::runtime_error("Cant find var"s);
+            }
+        }
+        return *value;
+    }
+
+    const std::vector<std::string>& VariableValue::GetDottedIds() const {
+        return dotted_ids_;
+    }
+
+    void VariableValue::SetSlot(size_t slot) {
+        slot_ = slot;
+    }
+
+    optional<size_t> VariableValue::GetSlot() const {
+        return slot_;
+    }
+
+    unique_ptr<Print> Print::Variable(const std::string& name) {
+        return std::make_unique<Print>(std::make_unique<VariableValue>(name));
+    }
+
+    Print::Print(unique_ptr<Statement> argument) {
+        args_.push_back(std::move(argument));
+    }
+
+    Print::Print(vector<unique_ptr<Statement>> args) 
+        : args_(std::move(args)){}
+
+    ObjectHolder Print::Execute(Closure& closure, Context& context) {
+        ObjectHolder obj;
+        bool first_arg = true;
+        for (const auto& arg : args_) {
+            if (!first_arg) {
+                context.GetOutputStream() << " "s;
+            }
+            first_arg = false;
+            const ObjectHolder& value = Pin(arg->Borrow(closure, context, obj), obj);
+            if (value) {
+                value->Print(context.GetOutputStream(), context);
+            }
+            else {
+                context.GetOutputStream() << "None"s;
+            }
+        }
+        context.GetOutputStream() << "\n"s;
+        return {};
+    }
+
+    const vector<unique_ptr<Statement>>& Print::GetArgs() const {
+        return args_;
+    }
+
+    vector<unique_ptr<Statement>>& Print::Args() {
+        return args_;
+    }
+
+    MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
+        std::vector<std::unique_ptr<Statement>> args) 
+        : object_(std::move(object))
+        , method_(std::move(method))
+        , args_(std::move(args)) {}
+
+    const runtime::Method* MethodCache::Lookup(const runtime::Class& cls, const std::string& name,
+        size_t argument_count) {
+        for (size_t i = 0; i < size_; ++i) {
+            if (entries_[i].cls == &cls) {
+                ++hits_;
+                return entries_[i].method;
+            }
+        }
+        ++misses_;
+        const runtime::Method* method = cls.GetMethod(name);
+        if (method != nullptr && method->formal_params.size() != argument_count) {
+            method = nullptr;
+        }
+        // Отсутствие метода тоже запоминается: такой вызов возвращает None
+        if (size_ < CAPACITY) {
+            entries_[size_++] = { &cls, method };
+        }
+        return method;
+    }
+
+    size_t MethodCache::GetHits() const {
+        return hits_;
+    }
+
+    size_t MethodCache::GetMisses() const {
+        return misses_;
+    }
+
+    ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
+        const auto obj = object_->Execute(closure, context);
+        const auto class_instance_ptr = obj.TryAs<runtime::ClassInstance>();
+        if (!class_instance_ptr) {
+            return {};
+        }
+        const auto* method = cache_.Lookup(class_instance_ptr->GetClass(), method_, args_.size());
+        if (method) {
+            std::vector<runtime::ObjectHolder> actual_args;
+            actual_args.reserve(args_.size());
+            for (const auto& arg : args_) {
+                actual_args.push_back(arg->Execute(closure, context));
+            }
+            return class_instance_ptr->Call(*method, actual_args, context);
+        }
+        return {};
+    }
+
+    const Statement& MethodCall::GetObject() const {
+        return *object_;
+    }
+
+    const std::string& MethodCall::GetMethodName() const {
+        return method_;
+    }
+
+    const vector<unique_ptr<Statement>>& MethodCall::GetArgs() const {
+        return args_;
+    }
+
+    const MethodCache& MethodCall::GetCache() const {
+        return cache_;
+    }
+
+    unique_ptr<Statement>& MethodCall::Object() {
+        return object_;
+    }
+
+    vector<unique_ptr<Statement>>& MethodCall::Args() {
+        return args_;
+    }
+
+    ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
+        ObjectHolder temp;
+        const ObjectHolder& obj = Pin(argument_->Borrow(closure, context, temp), temp);
+        if (!obj) {
+            return ObjectHolder::Own(runtime::String{ "None"s });
+        }
+        runtime::DummyContext dummy_context;
+        obj->Print(dummy_context.output, dummy_context);
+        return ObjectHolder::Own(runtime::String{ dummy_context.output.str() });
+    }
+
+    ObjectHolder Add::Execute(Closure& closure, Context& context) {
+        ObjectHolder lhs_temp;
+        ObjectHolder rhs_temp;
+        const auto [lhs, rhs] = BorrowOperands(closure, context, lhs_temp, rhs_temp);
+        return runtime::Add(*lhs, *rhs, context);
+    }
+
+    ObjectHolder Sub::Execute(Closure& closure, Context& context) {
+        ObjectHolder lhs_temp;
+        ObjectHolder rhs_temp;
+        const auto [lhs, rhs] = BorrowOperands(closure, context, lhs_temp, rhs_temp);
+        return runtime::Sub(*lhs, *rhs);
+    }
+
+    ObjectHolder Mult::Execute(Closure& closure, Context& context) {
+        ObjectHolder lhs_temp;
+        ObjectHolder rhs_temp;
+        const auto [lhs, rhs] = BorrowOperands(closure, context, lhs_temp, rhs_temp);
+        return runtime::Mult(*lhs, *rhs);
+    }
+
+    ObjectHolder Div::Execute(Closure& closure, Context& context) {
+        ObjectHolder lhs_temp;
+        ObjectHolder rhs_temp;
+        const auto [lhs, rhs] = BorrowOperands(closure, context, lhs_temp, rhs_temp);
+        return runtime::Div(*lhs, *rhs);
+    }
+
+    std::pair<const ObjectHolder*, const ObjectHolder*> BinaryOperation::BorrowOperands(
+        Closure& closure, Context& context, ObjectHolder& lhs_temp, ObjectHolder& rhs_temp) {
+        const ObjectHolder* lhs = &lhs_temp;
+        if (rhs_->IsSideEffectFree()) {
+            lhs = &lhs_->Borrow(closure, context, lhs_temp);
+        }
+        else {
+            lhs_temp = lhs_->Execute(closure, context);
+        }
+        const ObjectHolder* rhs = &rhs_->Borrow(closure, context, rhs_temp);
+        // Операция над экземпляром вызывает его методы, которые могут изменить хранилища
+        // обоих заимствованных операндов, поэтому операнды копируются
+        if (lhs->GetKind() == runtime::ObjectKind::ClassInstance) {
+            if (lhs != &lhs_temp) {
+                lhs_temp = *lhs;
+                lhs = &lhs_temp;
+            }
+            if (rhs != &rhs_temp) {
+                rhs_temp = *rhs;
+                rhs = &rhs_temp;
+            }
+        }
+        return { lhs, rhs };
+    }
+
+    void Compound::AddStatement(std::unique_ptr<Statement> stmt)
+    {
+        stmt_.push_back(std::move(stmt));
+    }
+
+    ObjectHolder Compound::Execute(Closure& closure, Context& context) {
+        for (const auto& statement : stmt_) {
+            statement->Execute(closure, context);
+            if (context.IsReturning()) {
+                break;
+            }
+        }
+        return {};
+    }
+
+    const vector<unique_ptr<Statement>>& Compound::GetStatements() const {
+        return stmt_;
+    }
+
+    vector<unique_ptr<Statement>>& Compound::Statements() {
+        return stmt_;
+    }
+
+    
+    Return::Return(std::unique_ptr<Statement> statement)
+        : statement_(std::move(statement)) {}
+
+    ObjectHolder Return::Execute(Closure& closure, Context& context) {
+        context.SetReturnValue(statement_->Execute(closure, context));
+        return {};
+    }
+
+    const Statement& Return::GetStatement() const {
+        return *statement_;
+    }
+
+    unique_ptr<Statement>& Return::ReturnValue() {
+        return statement_;
+    }
+
+    ClassDefinition::ClassDefinition(ObjectHolder cls) 
+        : cls_(cls){}
+
+    ObjectHolder ClassDefinition::Execute(Closure& closure, Context& context) {
+        // Определение продолжает владеть классом: на него ссылаются экземпляры
+        // и кэши мест вызова, а внутри метода объявление выполняется при каждом вызове
+        if (slot_) {
+            context.GetFrames()[*slot_] = cls_;
+            return {};
+        }
+        const auto obj = cls_.TryAs<runtime::Class>();
+        closure[obj->GetName()] = cls_;
+        return {};
+    }
+
+    const ObjectHolder& ClassDefinition::GetClass() const {
+        return cls_;
+    }
+
+    void ClassDefinition::SetSlot(size_t slot) {
+        slot_ = slot;
+    }
+
+    FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
+        std::unique_ptr<Statement> rv)
+        : object_(std::move(object))
+        , field_name_(std::move(field_name))
+        , rv_(std::move(rv)) {}
+
+    ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
+        const auto obj = object_.Execute(closure, context);
+        const auto class_inst_ptr = obj.TryAs<runtime::ClassInstance>();
+        if (class_inst_ptr) {
+            // Правая часть вычисляется до поиска поля, так как может добавить объекту поля
+            ObjectHolder value = rv_->Execute(closure, context);
+            return cache_.Set(*class_inst_ptr, field_name_, std::move(value));
+        }
+        throw std::runtime_error("Cant find field"s);
+    }
+
+    const VariableValue& FieldAssignment::GetObject() const {
+        return object_;
+    }
+
+    const runtime::FieldCache& FieldAssignment::GetCache() const {
+        return cache_;
+    }
+
+    const std::string& FieldAssignment::GetFieldName() const {
+        return field_name_;
+    }
+
+    const Statement& FieldAssignment::GetRightValue() const {
+        return *rv_;
+    }
+
+    VariableValue& FieldAssignment::Object() {
+        return object_;
+    }
+
+    unique_ptr<Statement>& FieldAssignment::RightValue() {
+        return rv_;
+    }
+
+    IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
+        std::unique_ptr<Statement> else_body) 
+        : condition_(std::move(condition))
+        , if_body_(std::move(if_body))
+        , else_body_(std::move(else_body)){}
+
+    ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
+        ObjectHolder temp;
+        if (runtime::IsTrue(condition_->Borrow(closure, context, temp))) {
+            return if_body_->Execute(closure, context);
+        }
+        else if (else_body_ != nullptr) {
+            return else_body_->Execute(closure, context);
+        }
+        else {
+            return ObjectHolder::None();
+        }
+    }
+
+    const Statement& IfElse::GetCondition() const {
+        return *condition_;
+    }
+
+    const Statement& IfElse::GetIfBody() const {
+        return *if_body_;
+    }
+
+    const Statement* IfElse::GetElseBody() const {
+        return else_body_.get();
+    }
+
+    unique_ptr<Statement>& IfElse::Condition() {
+        return condition_;
+    }
+
+    unique_ptr<Statement>& IfElse::IfBody() {
+        return if_body_;
+    }
+
+    unique_ptr<Statement>& IfElse::ElseBody() {
+        return else_body_;
+    }
+
+    ObjectHolder Or::Execute(Closure& closure, Context& context) {
+        ObjectHolder temp;
+        const bool lhs = runtime::IsTrue(lhs_->Borrow(closure, context, temp));
+        const bool rhs = runtime::IsTrue(rhs_->Borrow(closure, context, temp));
+        bool result = (lhs || rhs);
+        return runtime::ObjectHolder::Own(runtime::Bool{ result });
+    }
+
+    ObjectHolder And::Execute(Closure& closure, Context& context) {
+        ObjectHolder temp;
+        const bool lhs = runtime::IsTrue(lhs_->Borrow(closure, context, temp));
+        const bool rhs = runtime::IsTrue(rhs_->Borrow(closure, context, temp));
+        bool result = (lhs && rhs);
+        return runtime::ObjectHolder::Own(runtime::Bool{ result });
+    }
+
+    ObjectHolder Not::Execute(Closure& closure, Context& context) {
+        ObjectHolder temp;
+        bool result = !runtime::IsTrue(argument_->Borrow(closure, context, temp));
+        return runtime::ObjectHolder::Own(runtime::Bool{ result });
+    }
+
+    Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
+        : BinaryOperation(std::move(lhs), std::move(rhs))
+        , cmp_(std::move(cmp)){}
+
+    ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
+        ObjectHolder lhs_temp;
+        ObjectHolder rhs_temp;
+        const auto [lhs, rhs] = BorrowOperands(closure, context, lhs_temp, rhs_temp);
+        bool result = cmp_(*lhs, *rhs, context);
+        return runtime::ObjectHolder::Own(runtime::Bool{ result });
+    }
+
+    const Comparison::Comparator& Comparison::GetComparator() const {
+        return cmp_;
+    }
+
+    NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args) 
+        : class_(class_)
+        , args_(std::move(args)){}
+
+    NewInstance::NewInstance(const runtime::Class& class_) 
+        : class_(class_){}
+
+    ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
+        std::vector<runtime::ObjectHolder> actual_args;
+        for (const auto& arg : args_) {
+            actual_args.push_back(arg->Execute(closure, context));
+        }
+        auto instance = runtime::ClassInstance::Create(class_);
+        auto* instance_ptr = instance.TryAs<runtime::ClassInstance>();
+        if (const auto* init = instance_ptr->GetSpecialMethod(runtime::SpecialMethod::Init, args_.size())) {
+            instance_ptr->Call(*init, actual_args, context);
+        }
+        return instance;
+    }
+
+    const runtime::Class& NewInstance::GetClass() const {
+        return class_;
+    }
+
+    const vector<unique_ptr<Statement>>& NewInstance::GetArgs() const {
+        return args_;
+    }
+
+    vector<unique_ptr<Statement>>& NewInstance::Args() {
+        return args_;
+    }
+
+    MethodBody::MethodBody(std::unique_ptr<Statement>&& body) : body_(std::move(body)){}
+
+    ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
+        if (frame_size_ == 0) {
+            body_->Execute(closure, context);
+        }
+        else {
+            runtime::FrameStack::ScopedFrame frame(context.GetFrames(), frame_size_);
+            for (size_t slot = 0; slot < param_names_.size(); ++slot) {
+                if (const auto it = closure.find(param_names_[slot]); it != closure.end()) {
+                    context.GetFrames()[slot] = it->second;
+                }
+            }
+            body_->Execute(closure, context);
+        }
+        if (context.IsReturning()) {
+            return context.TakeReturnValue();
+        }
+        return runtime::ObjectHolder::None();
+    }
+
+    ObjectHolder MethodBody::Invoke(const runtime::Method& method, const ObjectHolder& self,
+        const vector<ObjectHolder>& args, Context& context) {
+        if (frame_size_ == 0) {
+            return Statement::Invoke(method, self, args, context);
+        }
+        {
+            auto& frames = context.GetFrames();
+            runtime::FrameStack::ScopedFrame frame(frames, frame_size_);
+            frames[0] = self;
+            for (size_t i = 0; i < args.size(); ++i) {
+                frames[i + 1] = args[i];
+            }
+            // Переменные тела хранятся в кадре, closure остаётся пустым
+            Closure closure;
+            body_->Execute(closure, context);
+        }
+        if (context.IsReturning()) {
+            return context.TakeReturnValue();
+        }
+        return runtime::ObjectHolder::None();
+    }
+
+    const Statement& MethodBody::GetBody() const {
+        return *body_;
+    }
+
+    unique_ptr<Statement>& MethodBody::Body() {
+        return body_;
+    }
+
+    void MethodBody::SetFrameLayout(vector<string> param_names, size_t frame_size) {
+        param_names_ = std::move(param_names);
+        frame_size_ = frame_size;
+    }
+
+    size_t MethodBody::GetFrameSize() const {
+        return frame_size_;
+    }
+
+    LazyMethodBody::LazyMethodBody(Loader loader)
+        : loader_(std::move(loader)) {
+    }
+
+    ObjectHolder LazyMethodBody::Execute(Closure& closure, Context& context) {
+        return Load().Execute(closure, context);
+    }
+
+    ObjectHolder LazyMethodBody::Invoke(const runtime::Method& method, const ObjectHolder& self,
+        const vector<ObjectHolder>& args, Context& context) {
+        return Load().Invoke(method, self, args, context);
+    }
+
+    runtime::Executable& LazyMethodBody::Load() {
+        if (!body_) {
+            unique_ptr<Statement> body = loader_();
+            body_ = transform_ ? transform_(std::move(body)) : std::move(body);
+            loader_ = nullptr;
+        }
+        return *body_;
+    }
+
+    bool LazyMethodBody::IsLoaded() const {
+        return body_ != nullptr;
+    }
+
+    void LazyMethodBody::SetTransform(Transform transform) {
+        if (body_) {
+            body_ = transform(std::move(body_));
+        }
+        else {
+            transform_ = std::move(transform);
+        }
+    }
+
+}  // namespace ast
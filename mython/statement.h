@@ -1,339 +1,551 @@
-#pragma once
-
-#include "runtime.h"
-
-#include <functional>
-
-namespace ast {
-
-    using Statement = runtime::Executable;
-
-    // Выражение, возвращающее значение типа T,
-    // используется как основа для создания констант
-    template <typename T>
-    class ValueStatement : public Statement {
-    public:
-        explicit ValueStatement(T v)
-            : value_(std::move(v)) {
-        }
-
-        runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
-            [[maybe_unused]] runtime::Context& context) override {
-            return runtime::ObjectHolder::Share(value_);
-        }
-
-    private:
-        T value_;
-    };
-
-    using NumericConst = ValueStatement<runtime::Number>;
-    using StringConst = ValueStatement<runtime::String>;
-    using BoolConst = ValueStatement<runtime::Bool>;
-
-    /*
-    Вычисляет значение переменной либо цепочки вызовов полей объектов id1.id2.id3.
-    Например, выражение circle.center.x - цепочка вызовов полей объектов в инструкции:
-    x = circle.center.x
-    */
-    class VariableValue : public Statement {
-    public:
-        explicit VariableValue(const std::string& var_name);
-        explicit VariableValue(std::vector<std::string> dotted_ids);
-
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-    private:
-        std::vector<std::string> dotted_ids_;
-    };
-
-    // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
-    class Assignment : public Statement {
-    public:
-        Assignment(std::string var, std::unique_ptr<Statement> rv);
-
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    
-    private:
-        std::string var_;
-        std::unique_ptr<Statement> rv_;
-    };
-
-    // Присваивает полю object.field_name значение выражения rv
-    class FieldAssignment : public Statement {
-    public:
-        FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
-
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-  
-    private:
-        VariableValue object_;
-        std::string field_name_;
-        std::unique_ptr<Statement> rv_;
-    };
-
-    // Значение None
-    class None : public Statement {
-    public:
-        runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
-            [[maybe_unused]] runtime::Context& context) override {
-            return {};
-        }
-    };
-
-    // Команда print
-    class Print : public Statement {
-    public:
-        // Инициализирует команду print для вывода значения выражения argument
-        explicit Print(std::unique_ptr<Statement> argument);
-        // Инициализирует команду print для вывода списка значений args
-        explicit Print(std::vector<std::unique_ptr<Statement>> args);
-
-        // Инициализирует команду print для вывода значения переменной name
-        static std::unique_ptr<Print> Variable(const std::string& name);
-
-        // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
-        // context.GetOutputStream()
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    private:
-        std::vector<std::unique_ptr<Statement>> args_;
-    };
-
-    // Вызывает метод object.method со списком параметров args
-    class MethodCall : public Statement {
-    public:
-        MethodCall(std::unique_ptr<Statement> object, std::string method,
-            std::vector<std::unique_ptr<Statement>> args);
-
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-   
-    private:
-        std::unique_ptr<Statement> object_;
-        std::string method_;
-        std::vector<std::unique_ptr<Statement>> args_;
-    };
-
-    /*
-    Создаёт новый экземпляр класса class_, передавая его конструктору набор параметров args.
-    Если в классе отсутствует метод __init__ с заданным количеством аргументов,
-    то экземпляр класса создаётся без вызова конструктора (поля объекта не будут проинициализированы):
-
-    class Person:
-      def set_name(name):
-        self.name = name
-
-    p = Person()
-    # Поле name будет иметь значение только после вызова метода set_name
-    p.set_name("Ivan")
-    */
-    class NewInstance : public Statement {
-    public:
-        explicit NewInstance(const runtime::Class& class_);
-        NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
-        // Возвращает объект, содержащий значение типа ClassInstance
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-    private:
-        runtime::ClassInstance cls_;
-        std::vector<std::unique_ptr<Statement>> args_;
-    };
-
-    // Базовый класс для унарных операций
-    class UnaryOperation : public Statement {
-    public:
-        explicit UnaryOperation(std::unique_ptr<Statement> argument) 
-            : argument_(std::move(argument)) {}
-    protected:
-        std::unique_ptr<Statement> argument_;
-    };
-
-    // Операция str, возвращающая строковое значение своего аргумента
-    class Stringify : public UnaryOperation {
-    public:
-        using UnaryOperation::UnaryOperation;
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Родительский класс Бинарная операция с аргументами lhs и rhs
-    class BinaryOperation : public Statement {
-    public:
-        BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs) 
-            : lhs_(std::move(lhs))
-            , rhs_(std::move(rhs)) {}
-    protected:
-        std::unique_ptr<Statement> lhs_;
-        std::unique_ptr<Statement> rhs_;
-    };
-
-    // Возвращает результат операции + над аргументами lhs и rhs
-    class Add : public BinaryOperation {
-    public:
-        using BinaryOperation::BinaryOperation;
-
-        // Поддерживается сложение:
-        //  число + число
-        //  строка + строка
-        //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
-        // В противном случае при вычислении выбрасывается runtime_error
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Возвращает результат вычитания аргументов lhs и rhs
-    class Sub : public BinaryOperation {
-    public:
-        using BinaryOperation::BinaryOperation;
-
-        // Поддерживается вычитание:
-        //  число - число
-        // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Возвращает результат умножения аргументов lhs и rhs
-    class Mult : public BinaryOperation {
-    public:
-        using BinaryOperation::BinaryOperation;
-
-        // Поддерживается умножение:
-        //  число * число
-        // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Возвращает результат деления lhs и rhs
-    class Div : public BinaryOperation {
-    public:
-        using BinaryOperation::BinaryOperation;
-
-        // Поддерживается деление:
-        //  число / число
-        // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
-        // Если rhs равен 0, выбрасывается исключение runtime_error
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Возвращает результат вычисления логической операции or над lhs и rhs
-    class Or : public BinaryOperation {
-    public:
-        using BinaryOperation::BinaryOperation;
-        // Значение аргумента rhs вычисляется, только если значение lhs
-        // после приведения к Bool равно False
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Возвращает результат вычисления логической операции and над lhs и rhs
-    class And : public BinaryOperation {
-    public:
-        using BinaryOperation::BinaryOperation;
-        // Значение аргумента rhs вычисляется, только если значение lhs
-        // после приведения к Bool равно True
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Возвращает результат вычисления логической операции not над единственным аргументом операции
-    class Not : public UnaryOperation {
-    public:
-        using UnaryOperation::UnaryOperation;
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    };
-
-    // Составная инструкция (например: тело метода, содержимое ветки if, либо else)
-    class Compound : public Statement {
-    public:
-        // Конструирует Compound из нескольких инструкций типа unique_ptr<Statement>
-        template <typename... Args>
-        explicit Compound(Args&&... args) {
-            if constexpr (sizeof...(Args) > 0) {
-                CompoundImpl(args...);
-            }
-        }
-
-        // Добавляет очередную инструкцию в конец составной инструкции
-        void AddStatement(std::unique_ptr<Statement> stmt); 
-      
-        // Последовательно выполняет добавленные инструкции. Возвращает None
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-    private:
-        std::vector<std::unique_ptr<Statement>> stmt_;
-        template<typename T0, typename... Ts>
-        void CompoundImpl(T0& v0, Ts&... vs) {
-            if constexpr (sizeof...(vs) != 0) {
-                stmt_.push_back(std::move(v0));
-                CompoundImpl(vs...);
-            }
-            else {
-                stmt_.push_back(std::move(v0));
-            }
-        }
-    };
-
-    // Тело метода. Как правило, содержит составную инструкцию
-    class MethodBody : public Statement {
-    public:
-        explicit MethodBody(std::unique_ptr<Statement>&& body);
-
-        // Вычисляет инструкцию, переданную в качестве body.
-        // Если внутри body была выполнена инструкция return, возвращает результат return
-        // В противном случае возвращает None
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    private:
-        std::unique_ptr<Statement> body_;
-    };
-
-    // Выполняет инструкцию return с выражением statement
-    class Return : public Statement {
-    public:
-        explicit Return(std::unique_ptr<Statement> statement); 
-
-        // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
-        // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-   
-    private:
-        std::unique_ptr<Statement> statement_;
-    };
-
-    // Объявляет класс
-    class ClassDefinition : public Statement {
-    public:
-        // Гарантируется, что ObjectHolder содержит объект типа runtime::Class
-        explicit ClassDefinition(runtime::ObjectHolder cls);
-
-        // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
-        // конструктор
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    private:
-        runtime::ObjectHolder cls_;
-    };
-
-    // Инструкция if <condition> <if_body> else <else_body>
-    class IfElse : public Statement {
-    public:
-        // Параметр else_body может быть равен nullptr
-        IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
-            std::unique_ptr<Statement> else_body);
-
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    private:
-        std::unique_ptr<Statement> condition_;
-        std::unique_ptr<Statement> if_body_;
-        std::unique_ptr<Statement> else_body_;
-    };
-
-    // Операция сравнения
-    class Comparison : public BinaryOperation {
-    public:
-        // Comparator задаёт функцию, выполняющую сравнение значений аргументов
-        using Comparator = std::function<bool(const runtime::ObjectHolder&,
-            const runtime::ObjectHolder&, runtime::Context&)>;
-
-        Comparison(Comparator cmp, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
-
-        // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
-        // приведённый к типу runtime::Bool
-        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    private:
-        Comparator cmp_;
-    };
-
-}  // namespace ast
+#pragma once
+
+#include "runtime.h"
+
+#include <array>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace ast {
+
+    using Statement = runtime::Executable;
+
+    // Выражение, возвращающее значение типа T,
+    // используется как основа для создания констант
+    template <typename T>
+    class ValueStatement : public Statement {
+    public:
+        explicit ValueStatement(T v)
+            : value_(std::move(v)) {
+        }
+
+        runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
+            [[maybe_unused]] runtime::Context& context) override {
+            // Числа и логические значения копируются внутрь ObjectHolder без выделения памяти
+            if constexpr (std::is_same_v<T, runtime::Number> || std::is_same_v<T, runtime::Bool>) {
+                return runtime::ObjectHolder::Own(T(value_));
+            }
+            else {
+                return runtime::ObjectHolder::Share(value_);
+            }
+        }
+
+        [[nodiscard]] bool IsSideEffectFree() const override {
+            return true;
+        }
+
+        [[nodiscard]] const T& GetValue() const {
+            return value_;
+        }
+
+    private:
+        T value_;
+    };
+
+    using NumericConst = ValueStatement<runtime::Number>;
+    using StringConst = ValueStatement<runtime::String>;
+    using BoolConst = ValueStatement<runtime::Bool>;
+
+    /*
+    Вычисляет значение переменной либо цепочки вызовов полей объектов id1.id2.id3.
+    Например, выражение circle.center.x - цепочка вызовов полей объектов в инструкции:
+    x = circle.center.x
+    */
+    class VariableValue : public Statement {
+    public:
+        explicit VariableValue(const std::string& var_name);
+        explicit VariableValue(std::vector<std::string> dotted_ids);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        // Возвращает ссылку на значение в closure, слоте кадра или поле объекта
+        const runtime::ObjectHolder& Borrow(runtime::Closure& closure, runtime::Context& context,
+            runtime::ObjectHolder& temp) override;
+
+        [[nodiscard]] bool IsSideEffectFree() const override {
+            return true;
+        }
+
+        [[nodiscard]] const std::vector<std::string>& GetDottedIds() const;
+
+        // Связывает первый идентификатор цепочки со слотом кадра метода. Значение переменной
+        // без слота ищется по имени в closure
+        void SetSlot(size_t slot);
+        [[nodiscard]] std::optional<size_t> GetSlot() const;
+
+    private:
+        std::vector<std::string> dotted_ids_;
+        // Кэши обращений к полям, по одному на каждый идентификатор цепочки, кроме первого
+        std::vector<runtime::FieldCache> field_caches_;
+        std::optional<size_t> slot_;
+    };
+
+    // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
+    class Assignment : public Statement {
+    public:
+        Assignment(std::string var, std::unique_ptr<Statement> rv);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const std::string& GetVarName() const;
+        [[nodiscard]] const Statement& GetRightValue() const;
+        std::unique_ptr<Statement>& RightValue();
+
+        // Связывает переменную со слотом кадра метода. Переменная без слота хранится в closure
+        void SetSlot(size_t slot);
+        [[nodiscard]] std::optional<size_t> GetSlot() const;
+    
+    private:
+        std::string var_;
+        std::unique_ptr<Statement> rv_;
+        std::optional<size_t> slot_;
+    };
+
+    // Присваивает полю object.field_name значение выражения rv
+    class FieldAssignment : public Statement {
+    public:
+        FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const VariableValue& GetObject() const;
+        [[nodiscard]] const std::string& GetFieldName() const;
+        [[nodiscard]] const Statement& GetRightValue() const;
+        VariableValue& Object();
+        std::unique_ptr<Statement>& RightValue();
+
+        [[nodiscard]] const runtime::FieldCache& GetCache() const;
+  
+    private:
+        VariableValue object_;
+        std::string field_name_;
+        std::unique_ptr<Statement> rv_;
+        runtime::FieldCache cache_;
+    };
+
+    // Значение None
+    class None : public Statement {
+    public:
+        runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
+            [[maybe_unused]] runtime::Context& context) override {
+            return {};
+        }
+    };
+
+    // Команда print
+    class Print : public Statement {
+    public:
+        // Инициализирует команду print для вывода значения выражения argument
+        explicit Print(std::unique_ptr<Statement> argument);
+        // Инициализирует команду print для вывода списка значений args
+        explicit Print(std::vector<std::unique_ptr<Statement>> args);
+
+        // Инициализирует команду print для вывода значения переменной name
+        static std::unique_ptr<Print> Variable(const std::string& name);
+
+        // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
+        // context.GetOutputStream()
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const;
+        std::vector<std::unique_ptr<Statement>>& Args();
+
+    private:
+        std::vector<std::unique_ptr<Statement>> args_;
+    };
+
+    /*
+    Встроенный кэш места вызова метода. Запоминает результат поиска метода для нескольких
+    классов получателя, поэтому повторный вызов с объектом уже встречавшегося класса
+    сводится к сравнению указателей. Если классов больше, чем помещается в кэш,
+    метод ищется в таблице класса при каждом вызове
+    */
+    class MethodCache {
+    public:
+        static constexpr size_t CAPACITY = 4;
+
+        // Возвращает метод name класса cls, принимающий argument_count параметров,
+        // либо nullptr, если такого метода нет
+        const runtime::Method* Lookup(const runtime::Class& cls, const std::string& name,
+            size_t argument_count);
+
+        // Количество обращений, обслуженных кэшем, и обращений, потребовавших поиска в классе
+        [[nodiscard]] size_t GetHits() const;
+        [[nodiscard]] size_t GetMisses() const;
+
+    private:
+        struct Entry {
+            const runtime::Class* cls = nullptr;
+            const runtime::Method* method = nullptr;
+        };
+
+        std::array<Entry, CAPACITY> entries_;
+        size_t size_ = 0;
+        size_t hits_ = 0;
+        size_t misses_ = 0;
+    };
+
+    // Вызывает метод object.method со списком параметров args
+    class MethodCall : public Statement {
+    public:
+        MethodCall(std::unique_ptr<Statement> object, std::string method,
+            std::vector<std::unique_ptr<Statement>> args);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const Statement& GetObject() const;
+        [[nodiscard]] const std::string& GetMethodName() const;
+        [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const;
+        std::unique_ptr<Statement>& Object();
+        std::vector<std::unique_ptr<Statement>>& Args();
+
+        [[nodiscard]] const MethodCache& GetCache() const;
+   
+    private:
+        std::unique_ptr<Statement> object_;
+        std::string method_;
+        std::vector<std::unique_ptr<Statement>> args_;
+        MethodCache cache_;
+    };
+
+    /*
+    Создаёт новый экземпляр класса class_, передавая его конструктору набор параметров args.
+    Каждое выполнение создаёт отдельный экземпляр.
+    Если в классе отсутствует метод __init__ с заданным количеством аргументов,
+    то экземпляр класса создаётся без вызова конструктора (поля объекта не будут проинициализированы):
+
+    class Person:
+      def set_name(name):
+        self.name = name
+
+    p = Person()
+    # Поле name будет иметь значение только после вызова метода set_name
+    p.set_name("Ivan")
+    */
+    class NewInstance : public Statement {
+    public:
+        explicit NewInstance(const runtime::Class& class_);
+        NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
+        // Возвращает объект, содержащий значение типа ClassInstance
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const runtime::Class& GetClass() const;
+        [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const;
+        std::vector<std::unique_ptr<Statement>>& Args();
+
+    private:
+        const runtime::Class& class_;
+        std::vector<std::unique_ptr<Statement>> args_;
+    };
+
+    // Базовый класс для унарных операций
+    class UnaryOperation : public Statement {
+    public:
+        explicit UnaryOperation(std::unique_ptr<Statement> argument) 
+            : argument_(std::move(argument)) {}
+
+        [[nodiscard]] const Statement& GetArgument() const {
+            return *argument_;
+        }
+
+        std::unique_ptr<Statement>& Argument() {
+            return argument_;
+        }
+
+    protected:
+        std::unique_ptr<Statement> argument_;
+    };
+
+    // Операция str, возвращающая строковое значение своего аргумента
+    class Stringify : public UnaryOperation {
+    public:
+        using UnaryOperation::UnaryOperation;
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Родительский класс Бинарная операция с аргументами lhs и rhs
+    class BinaryOperation : public Statement {
+    public:
+        BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs) 
+            : lhs_(std::move(lhs))
+            , rhs_(std::move(rhs)) {}
+
+        [[nodiscard]] const Statement& GetLhs() const {
+            return *lhs_;
+        }
+
+        [[nodiscard]] const Statement& GetRhs() const {
+            return *rhs_;
+        }
+
+        std::unique_ptr<Statement>& Lhs() {
+            return lhs_;
+        }
+
+        std::unique_ptr<Statement>& Rhs() {
+            return rhs_;
+        }
+
+    protected:
+        // Вычисляет операнды, по возможности заимствуя их значения (см. Statement::Borrow).
+        // Левый операнд заимствуется, только если вычисление правого не может изменить
+        // его хранилище. Экземпляры классов закрепляются в lhs_temp и rhs_temp, так как
+        // операция над ними вызывает методы программы
+        std::pair<const runtime::ObjectHolder*, const runtime::ObjectHolder*> BorrowOperands(
+            runtime::Closure& closure, runtime::Context& context,
+            runtime::ObjectHolder& lhs_temp, runtime::ObjectHolder& rhs_temp);
+
+        std::unique_ptr<Statement> lhs_;
+        std::unique_ptr<Statement> rhs_;
+    };
+
+    // Возвращает результат операции + над аргументами lhs и rhs
+    class Add : public BinaryOperation {
+    public:
+        using BinaryOperation::BinaryOperation;
+
+        // Поддерживается сложение:
+        //  число + число
+        //  строка + строка
+        //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
+        // В противном случае при вычислении выбрасывается runtime_error
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Возвращает результат вычитания аргументов lhs и rhs
+    class Sub : public BinaryOperation {
+    public:
+        using BinaryOperation::BinaryOperation;
+
+        // Поддерживается вычитание:
+        //  число - число
+        // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Возвращает результат умножения аргументов lhs и rhs
+    class Mult : public BinaryOperation {
+    public:
+        using BinaryOperation::BinaryOperation;
+
+        // Поддерживается умножение:
+        //  число * число
+        // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Возвращает результат деления lhs и rhs
+    class Div : public BinaryOperation {
+    public:
+        using BinaryOperation::BinaryOperation;
+
+        // Поддерживается деление:
+        //  число / число
+        // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+        // Если rhs равен 0, выбрасывается исключение runtime_error
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Возвращает результат вычисления логической операции or над lhs и rhs
+    class Or : public BinaryOperation {
+    public:
+        using BinaryOperation::BinaryOperation;
+        // Значение аргумента rhs вычисляется, только если значение lhs
+        // после приведения к Bool равно False
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Возвращает результат вычисления логической операции and над lhs и rhs
+    class And : public BinaryOperation {
+    public:
+        using BinaryOperation::BinaryOperation;
+        // Значение аргумента rhs вычисляется, только если значение lhs
+        // после приведения к Bool равно True
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Возвращает результат вычисления логической операции not над единственным аргументом операции
+    class Not : public UnaryOperation {
+    public:
+        using UnaryOperation::UnaryOperation;
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    };
+
+    // Составная инструкция (например: тело метода, содержимое ветки if, либо else)
+    class Compound : public Statement {
+    public:
+        // Конструирует Compound из нескольких инструкций типа unique_ptr<Statement>
+        template <typename... Args>
+        explicit Compound(Args&&... args) {
+            if constexpr (sizeof...(Args) > 0) {
+                CompoundImpl(args...);
+            }
+        }
+
+        // Добавляет очередную инструкцию в конец составной инструкции
+        void AddStatement(std::unique_ptr<Statement> stmt); 
+      
+        // Последовательно выполняет добавленные инструкции, пока не будет выполнена инструкция
+        // return. Возвращает None
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetStatements() const;
+        std::vector<std::unique_ptr<Statement>>& Statements();
+
+    private:
+        std::vector<std::unique_ptr<Statement>> stmt_;
+        template<typename T0, typename... Ts>
+        void CompoundImpl(T0& v0, Ts&... vs) {
+            if constexpr (sizeof...(vs) != 0) {
+                stmt_.push_back(std::move(v0));
+                CompoundImpl(vs...);
+            }
+            else {
+                stmt_.push_back(std::move(v0));
+            }
+        }
+    };
+
+    // Тело метода. Как правило, содержит составную инструкцию
+    class MethodBody : public Statement {
+    public:
+        explicit MethodBody(std::unique_ptr<Statement>&& body);
+
+        // Вычисляет инструкцию, переданную в качестве body.
+        // Если внутри body была выполнена инструкция return, возвращает результат return
+        // В противном случае возвращает None.
+        // Если для тела задана раскладка кадра, перед выполнением создаётся кадр метода,
+        // в первые слоты которого копируются значения param_names из closure
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        // Если для тела задана раскладка кадра, выделяет кадр на вершине стека context
+        // и записывает self и args прямо в его слоты, не создавая Closure
+        runtime::ObjectHolder Invoke(const runtime::Method& method, const runtime::ObjectHolder& self,
+            const std::vector<runtime::ObjectHolder>& args, runtime::Context& context) override;
+
+        [[nodiscard]] const Statement& GetBody() const;
+        std::unique_ptr<Statement>& Body();
+
+        // Задаёт раскладку кадра метода: param_names - имена self и параметров метода,
+        // занимающих первые слоты, frame_size - общее число слотов вместе с локальными переменными
+        void SetFrameLayout(std::vector<std::string> param_names, size_t frame_size);
+        [[nodiscard]] size_t GetFrameSize() const;
+
+    private:
+        std::unique_ptr<Statement> body_;
+        std::vector<std::string> param_names_;
+        size_t frame_size_ = 0;
+    };
+
+    /*
+     * Тело метода, которое строится при первом вызове. До этого хранится только загрузчик,
+     * разбирающий исходный текст тела. Если загрузчик выбрасывает исключение, оно
+     * передаётся вызывающему, и следующий вызов повторяет загрузку
+     */
+    class LazyMethodBody : public Statement {
+    public:
+        using Loader = std::function<std::unique_ptr<Statement>()>;
+        // Преобразует построенное тело перед первым выполнением, например компилирует его
+        using Transform = std::function<std::unique_ptr<runtime::Executable>(std::unique_ptr<Statement>)>;
+
+        explicit LazyMethodBody(Loader loader);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+        runtime::ObjectHolder Invoke(const runtime::Method& method, const runtime::ObjectHolder& self,
+            const std::vector<runtime::ObjectHolder>& args, runtime::Context& context) override;
+
+        // Строит тело, если оно ещё не построено, и возвращает его
+        runtime::Executable& Load();
+        [[nodiscard]] bool IsLoaded() const;
+
+        // Задаёт преобразование тела. Уже построенное тело преобразуется сразу
+        void SetTransform(Transform transform);
+
+    private:
+        Loader loader_;
+        Transform transform_;
+        std::unique_ptr<runtime::Executable> body_;
+    };
+
+    // Выполняет инструкцию return с выражением statement
+    class Return : public Statement {
+    public:
+        explicit Return(std::unique_ptr<Statement> statement); 
+
+        // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
+        // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
+        // Результат передаётся через context.SetReturnValue, исключения не используются
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const Statement& GetStatement() const;
+        std::unique_ptr<Statement>& ReturnValue();
+   
+    private:
+        std::unique_ptr<Statement> statement_;
+    };
+
+    // Объявляет класс
+    class ClassDefinition : public Statement {
+    public:
+        // Гарантируется, что ObjectHolder содержит объект типа runtime::Class
+        explicit ClassDefinition(runtime::ObjectHolder cls);
+
+        // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
+        // конструктор
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const runtime::ObjectHolder& GetClass() const;
+
+        // Связывает имя класса со слотом кадра метода, внутри которого объявлен класс
+        void SetSlot(size_t slot);
+
+    private:
+        runtime::ObjectHolder cls_;
+        std::optional<size_t> slot_;
+    };
+
+    // Инструкция if <condition> <if_body> else <else_body>
+    class IfElse : public Statement {
+    public:
+        // Параметр else_body может быть равен nullptr
+        IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
+            std::unique_ptr<Statement> else_body);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const Statement& GetCondition() const;
+        [[nodiscard]] const Statement& GetIfBody() const;
+        // Возвращает nullptr, если ветка else отсутствует
+        [[nodiscard]] const Statement* GetElseBody() const;
+        std::unique_ptr<Statement>& Condition();
+        std::unique_ptr<Statement>& IfBody();
+        std::unique_ptr<Statement>& ElseBody();
+
+    private:
+        std::unique_ptr<Statement> condition_;
+        std::unique_ptr<Statement> if_body_;
+        std::unique_ptr<Statement> else_body_;
+    };
+
+    // Операция сравнения
+    class Comparison : public BinaryOperation {
+    public:
+        // Comparator задаёт функцию, выполняющую сравнение значений аргументов
+        using Comparator = std::function<bool(const runtime::ObjectHolder&,
+            const runtime::ObjectHolder&, runtime::Context&)>;
+
+        Comparison(Comparator cmp, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
+
+        // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
+        // приведённый к типу runtime::Bool
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        [[nodiscard]] const Comparator& GetComparator() const;
+
+    private:
+        Comparator cmp_;
+    };
+
+}  // namespace ast